@@ -0,0 +1,157 @@
+/**
+ * Functions for creating/using arena allocators.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+
+//every allocation is aligned to this many bytes
+#define ARENA_ALIGNMENT 16
+
+
+static struct arena_block *create_block(unsigned long size){
+	/**
+	 * Allocates a block with room for size bytes of data.  The block header
+	 * and its data share one allocation.
+	 */
+	unsigned long header = sizeof(struct arena_block);
+	header = (header + ARENA_ALIGNMENT - 1) & ~(unsigned long) (ARENA_ALIGNMENT - 1);
+	
+	struct arena_block *block = malloc(header + size);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	block->data = (unsigned char*) block + header;
+	return block;
+}
+
+
+Arena *create_arena(unsigned long block_size){
+	/**
+	 * Creates and returns an empty arena which allocates blocks of (at least)
+	 * the specified size.
+	 */
+	Arena *arena = malloc(sizeof(Arena));
+	arena->block_size = block_size;
+	arena->blocks = NULL;
+	
+	return arena;
+}
+
+
+void *arena_alloc(Arena *arena, unsigned long size){
+	/**
+	 * Returns a pointer to size bytes of uninitialized memory from the arena.
+	 * The memory remains valid until the arena is deleted.
+	 */
+	size = (size + ARENA_ALIGNMENT - 1) & ~(unsigned long) (ARENA_ALIGNMENT - 1);
+	
+	struct arena_block *block = arena->blocks;
+	if(block == NULL || block->used + size > block->size){
+		//oversized requests get a block of their own
+		unsigned long block_size = arena->block_size;
+		if(size > block_size){
+			block_size = size;
+		}
+		block = create_block(block_size);
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+	
+	void *memory = block->data + block->used;
+	block->used += size;
+	return memory;
+}
+
+
+void arena_merge(Arena *arena, Arena *other){
+	/**
+	 * Hands every block of other over to the arena, so that everything
+	 * allocated from other lives until the arena is deleted, then frees
+	 * other.  Nothing is copied.  The merged blocks go behind the arena's
+	 * current block, which keeps serving new allocations.
+	 */
+	if(other == NULL){
+		return;
+	}
+	struct arena_block *first = other->blocks;
+	free(other);
+	if(first == NULL){
+		return;
+	}
+	struct arena_block *last = first;
+	while(last->next != NULL){
+		last = last->next;
+	}
+	
+	if(arena->blocks == NULL){
+		arena->blocks = first;
+	}else{
+		last->next = arena->blocks->next;
+		arena->blocks->next = first;
+	}
+}
+
+
+void delete_arena(Arena *arena){
+	/**
+	 * Frees all memory associated with the provided arena, including
+	 * everything allocated from it.
+	 */
+	if(arena == NULL){
+		return;
+	}
+	struct arena_block *block = arena->blocks;
+	while(block != NULL){
+		struct arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	free(arena);
+}
+
+
+/*
+ * Tests
+ */
+int arena_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Arena Tests:\n\n");
+	
+	Arena *arena = create_arena(256);
+	int failures = 0;
+	int i;
+	
+	//small allocations are aligned and do not overlap
+	char *last = NULL;
+	for(i = 0; i < 100; i++){
+		char *p = arena_alloc(arena, 1 + i % 40);
+		if((unsigned long) p % ARENA_ALIGNMENT != 0 || p == last){
+			failures++;
+		}
+		p[0] = i;
+		last = p;
+	}
+	
+	//oversized allocations still work
+	char *big = arena_alloc(arena, 10000);
+	big[9999] = 1;
+	
+	//merged memory stays valid
+	Arena *other = create_arena(64);
+	char *moved = arena_alloc(other, 100);
+	moved[99] = 2;
+	arena_merge(arena, other);
+	if(moved[99] != 2 || big[9999] != 1){
+		failures++;
+	}
+	
+	printf("%d failures\n", failures);
+	delete_arena(arena);
+	
+	return failures != 0;
+}
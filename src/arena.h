@@ -0,0 +1,27 @@
+/**
+ * Region ("arena") allocator.  Memory is handed out from large blocks by
+ * bumping a pointer, and is only ever freed all at once when the arena is
+ * deleted.  This suits structures such as automata, which are built from
+ * many small objects that all die together.
+ */
+
+struct arena_block {
+	struct arena_block *next;
+	unsigned long size; //bytes of data in this block
+	unsigned long used; //bytes of data handed out so far
+	unsigned char *data;
+};
+
+typedef struct arena {
+	unsigned long block_size; //default size of new blocks
+	struct arena_block *blocks; //most recent block first
+} Arena;
+
+
+Arena *create_arena(unsigned long);
+void *arena_alloc(Arena*, unsigned long);
+void arena_merge(Arena*, Arena*);
+void delete_arena(Arena*);
+
+//test function
+int arena_test();
@@ -1,276 +1,377 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "arena.h"
 #include "automata.h"
 #include "print.h"
 
 
-static FiniteAutomaton *create_automaton_empty(int size){
+//size of the blocks of memory automata allocate their nodes from
+#define AUTOMATON_ARENA_BLOCK_SIZE 4096
+
+
+static FiniteAutomaton *create_automaton_shell(int size){
 	/**
-	 * Creates an empty automaton of the given size that, without modification,
-	 * accepts nothing.
+	 * Creates an automaton with room for the given number of nodes, but
+	 * without the nodes themselves; the caller must fill in every entry of
+	 * the node array.
 	 */
 	FiniteAutomaton *automaton = malloc(sizeof(FiniteAutomaton));
 	automaton->starting_state = 0;
 	automaton->n_nodes = size;
-	automaton->nodes = malloc(size * sizeof(struct automaton_node*));
+	automaton->arena = create_arena(AUTOMATON_ARENA_BLOCK_SIZE);
+	automaton->nodes = arena_alloc(automaton->arena,
+	                               size * sizeof(struct automaton_node*));
 	
-	//make empty nodes (no transitions)
+	//compiled table stuff
+	automaton->compiled = NULL;
+	
+	//graph layout stuff
+	automaton->graph = NULL;
+	automaton->simulator = NULL;
+	
+	return automaton;
+}
+
+
+static struct automaton_node *create_node(FiniteAutomaton *automaton,
+                                          int identifier){
+	/**
+	 * Makes an empty node (no transitions) with the given identifier and
+	 * places it in the automaton's node array.
+	 */
+	struct automaton_node *node;
+	node = arena_alloc(automaton->arena, sizeof(struct automaton_node));
+	AUTOMATON_STATS_ADD(nodes_created, 1);
+	node->identifier = identifier;
+	node->n_transitions = 0;
+	node->is_ending_state = 0;
+	node->token = 0;
+	node->transitions = NULL;
+	
+	automaton->nodes[identifier] = node;
+	return node;
+}
+
+
+FiniteAutomaton *create_automaton_empty(int size){
+	/**
+	 * Creates an empty automaton of the given size that, without modification,
+	 * accepts nothing.  All of its nodes and transitions are allocated from
+	 * the automaton's arena, and are freed with it.
+	 */
+	FiniteAutomaton *automaton = create_automaton_shell(size);
+	
+	//make empty nodes (no transitions), contiguous in memory
+	struct automaton_node *block;
+	block = arena_alloc(automaton->arena, size * sizeof(struct automaton_node));
+	AUTOMATON_STATS_ADD(nodes_created, size);
 	int i;
 	for(i = 0; i < size; i++){
-		struct automaton_node *node = malloc(sizeof(struct automaton_node));
+		struct automaton_node *node = block + i;
 		
 		node->identifier = i;
 		node->n_transitions = 0;
 		node->is_ending_state = 0;
+		node->token = 0;
 		node->transitions = NULL;
 		
 		automaton->nodes[i] = node;
 	}
 	
-	//lookup table stuff
-	automaton->lookup_table = NULL;
-	automaton->transition_chars = NULL;
-	automaton->n_transition_chars = 0;
-	
 	return automaton;
 }
 
 
-static void copy_nodes(struct automaton_node **old_nodes,
-                       struct automaton_node **new_nodes,
+struct automaton_transition *allocate_transitions(FiniteAutomaton *automaton,
+                                                  struct automaton_node *node,
+                                                  int n){
+	/**
+	 * Gives the node (which must belong to the automaton) n new transitions in
+	 * place of any it had.  The transitions are contiguous and zeroed, and are
+	 * returned for the caller to fill in.
+	 */
+	struct automaton_transition *transitions;
+	transitions = arena_alloc(automaton->arena,
+	                          n * sizeof(struct automaton_transition));
+	node->transitions = arena_alloc(automaton->arena,
+	                                n * sizeof(struct automaton_transition*));
+	node->n_transitions = n;
+	AUTOMATON_STATS_ADD(transitions_created, n);
+	
+	int i;
+	for(i = 0; i < n; i++){
+		transitions[i].is_epsilon = 0;
+		transitions[i].low = 0;
+		transitions[i].high = 0;
+		transitions[i].identifier = 0;
+		node->transitions[i] = transitions + i;
+	}
+	return transitions;
+}
+
+
+static struct automaton_transition *add_epsilon(FiniteAutomaton *automaton,
+                                                struct automaton_node *node,
+                                                int identifier){
+	/**
+	 * Appends a new epsilon transition to the given node (which must belong to
+	 * the automaton) and returns it.
+	 */
+	int nt = node->n_transitions + 1;
+	struct automaton_transition **new_transitions;
+	new_transitions = arena_alloc(automaton->arena,
+	                              nt * sizeof(struct automaton_transition*));
+	
+	//copy existing transitions
+	int i;
+	for(i = 0; i < nt - 1; i++){
+		new_transitions[i] = node->transitions[i];
+	}
+	
+	//new transition
+	struct automaton_transition *transition;
+	transition = arena_alloc(automaton->arena,
+	                         sizeof(struct automaton_transition));
+	transition->is_epsilon = 1;
+	transition->low = 0;
+	transition->high = 0;
+	transition->identifier = identifier;
+	new_transitions[nt - 1] = transition;
+	AUTOMATON_STATS_ADD(transitions_created, 1);
+	
+	node->n_transitions = nt;
+	node->transitions = new_transitions;
+	return transition;
+}
+
+
+static void copy_nodes(FiniteAutomaton *automaton,
+                       struct automaton_node **old_nodes,
                        int n_nodes, int offset){
 	/**
-	 * Copies the first n_nodes nodes from old_nodes to new_nodes starting at
-	 * position offset.  If offset is zero, it starts at the beginning.  Note 
-	 * that the copy is a deep copy; all transition objects are new.
+	 * Copies the first n_nodes nodes from old_nodes over the nodes of the
+	 * automaton starting at position offset.  If offset is zero, it starts at
+	 * the beginning.  Note that the copy is a deep copy; all transition
+	 * objects are new and allocated from the automaton.
 	 */
 	int i, j;
 	for(i = 0; i < n_nodes; i++){
 		int new_i = i + offset;
 		struct automaton_node *old_node, *new_node;
 		old_node = old_nodes[i];
-		new_node = malloc(sizeof(struct automaton_node));
+		new_node = automaton->nodes[new_i];
 		
 		new_node->identifier = new_i;
 		new_node->is_ending_state = old_node->is_ending_state;
+		new_node->token = old_node->token;
 		int nt = old_node->n_transitions;
-		new_node->n_transitions = nt;
 		
 		//make transitions
-		new_node->transitions = malloc(nt*sizeof(struct automaton_transition*));
+		struct automaton_transition *transitions;
+		transitions = allocate_transitions(automaton, new_node, nt);
 		for(j = 0; j < nt; j++){
-			struct automaton_transition *old_transition, *new_transition;
-			old_transition = old_node->transitions[j];
-			new_transition = malloc(sizeof(struct automaton_transition));
-			
-			*new_transition = *old_transition;
-			new_transition->identifier += offset;
-			
-			new_node->transitions[j] = new_transition;
+			transitions[j] = *old_node->transitions[j];
+			transitions[j].identifier += offset;
 		}
-		
-		new_nodes[new_i] = new_node;
 	}
 }
 
 
-static void delete_nodes(struct automaton_node **nodes, int n_nodes){
+static void splice_nodes(FiniteAutomaton *automaton, FiniteAutomaton *part,
+                         int offset){
 	/**
-	 * Frees all memory associated with the nodes provided
+	 * Moves the nodes of part into the automaton starting at position offset.
+	 * The nodes and their transitions are renumbered in place rather than
+	 * copied, and part's arena is handed over to the automaton, so part is
+	 * consumed.
 	 */
 	int i, j;
-	for(i = 0; i < n_nodes; i++){
-		struct automaton_node *node = nodes[i];
-		
+	for(i = 0; i < part->n_nodes; i++){
+		struct automaton_node *node = part->nodes[i];
+		node->identifier += offset;
 		for(j = 0; j < node->n_transitions; j++){
-			free(node->transitions[j]);
+			node->transitions[j]->identifier += offset;
 		}
-		free(node->transitions);
-		free(node);
+		automaton->nodes[i + offset] = node;
 	}
-	free(nodes);
+	
+	arena_merge(automaton->arena, part->arena);
+	delete_compiled_automaton(part->compiled);
+	delete_automaton_graph(part->graph);
+	delete_bit_parallel_automaton(part->simulator);
+	free(part);
 }
 
 
-static void encapsulate(FiniteAutomaton *automaton){
+static void redirect_endings(FiniteAutomaton *automaton, int first, int last,
+                             int identifier){
 	/**
-	 * Replaces the automaton at the provided address with a new automaton
-	 * identical, except with only one ending state.  Returns the identifier of
-	 * the new ending state.
+	 * Turns every ending node from first up to (but not including) last into
+	 * an ordinary node with an epsilon transition to the given node.
 	 */
-	if(automaton == NULL){
-		return;
+	int i;
+	for(i = first; i < last; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		if(node->is_ending_state){
+			node->is_ending_state = 0;
+			add_epsilon(automaton, node, identifier);
+		}
+	}
+}
+
+
+static int is_removable(FiniteAutomaton *automaton,
+                        struct automaton_node *node){
+	/**
+	 * Returns one if the node only passes control on: it is neither the
+	 * starting node nor an ending node, and its only transition is an epsilon
+	 * transition.
+	 */
+	if(node->identifier == automaton->starting_state){
+		return 0;
 	}
+	if(node->is_ending_state || node->n_transitions != 1){
+		return 0;
+	}
+	return node->transitions[0]->is_epsilon;
+}
+
+
+static void resolve_redirects(FiniteAutomaton *automaton, int *redirect,
+                              int *stack){
+	/**
+	 * Fills redirect with the node each node's inbound transitions should
+	 * lead to: the end of its chain of removable nodes, or the node itself if
+	 * it is kept.  Each node is visited once, since every chain is resolved
+	 * as a whole.  A chain which loops back on itself (accepting nothing) is
+	 * cut by keeping the node where the loop was found.  stack is scratch
+	 * space for n_nodes identifiers.
+	 */
 	int n = automaton->n_nodes;
-	struct automaton_node **old_nodes = automaton->nodes;
-	struct automaton_node **new_nodes = malloc((n + 1)*sizeof(struct automaton_node*));
-	
-	//make single endstate node
-	struct automaton_node *end = malloc(sizeof(struct automaton_node));
-	end->identifier = n;
-	end->n_transitions = 0;
-	end->is_ending_state = 1;
-	end->transitions = NULL;
-	new_nodes[n] = end;
-	
-	//copy old nodes
-	copy_nodes(old_nodes, new_nodes, n, 0);
+	int i;
+	for(i = 0; i < n; i++){
+		redirect[i] = -1; //unresolved
+	}
 	
-	//replace ending states with new transitions
-	int i, j;
 	for(i = 0; i < n; i++){
-		struct automaton_node *node = new_nodes[i];
-		if(node->is_ending_state){
-			//make not an ending state
-			node->is_ending_state = 0;
-			
-			//add new transition to real ending state
-			int nt = node->n_transitions + 1;
-			node->n_transitions = nt;
-			
-			struct automaton_transition **new_transitions = 
-						malloc(nt * sizeof(struct automaton_transition*));
-			//copy existing transitions
-			for(j = 0; j < nt - 1; j++){
-				new_transitions[j] = node->transitions[j];
+		//walk down the chain until reaching a resolved or kept node
+		int depth = 0;
+		int v = i;
+		while(redirect[v] == -1){
+			struct automaton_node *node = automaton->nodes[v];
+			if(!is_removable(automaton, node)){
+				redirect[v] = v;
+				break;
+			}
+			redirect[v] = -2; //on the current chain
+			stack[depth++] = v;
+			v = node->transitions[0]->identifier;
+		}
+		
+		int target = redirect[v];
+		if(target == -2){
+			//the chain loops; keep the node it loops back to
+			redirect[v] = v;
+			target = v;
+		}
+		while(depth > 0){
+			int u = stack[--depth];
+			if(redirect[u] == -2){
+				redirect[u] = target;
 			}
-			//new transition
-			struct automaton_transition *transition;
-			transition = malloc(sizeof(struct automaton_transition));
-			transition->is_epsilon = 1;
-			transition->identifier = n;
-			new_transitions[nt-1] = transition;
-			
-			free(node->transitions);
-			node->transitions = new_transitions;
 		}
 	}
-	
-	
-	//replace node object
-	automaton->n_nodes++;
-	automaton->nodes = new_nodes;
-	
-	//free memory from old nodes
-	delete_nodes(old_nodes, n);
 }
 
 
-static void reduce(FiniteAutomaton *automaton){
+void reduce_automaton(FiniteAutomaton *automaton){
 	/**
 	 * Reroutes the transitions in the given automaton to eliminate transitions
 	 * to and from non-finishing nodes with one epsilon transition and no other
 	 * transitions.  The starting node, however, will always be kept.  It also
-	 * removes all nodes with no inbound or outbound transitions.
+	 * removes all nodes with no inbound or outbound transitions.  Chains of
+	 * such nodes are followed once through a redirect table, and inbound
+	 * transitions are counted in one pass, so this takes time linear in the
+	 * number of nodes and transitions.  The nodes are renumbered in place, so
+	 * nothing is copied.
 	 */
-	int i, j, k;
-	for(i = 0; i < automaton->n_nodes; i++){
-		struct automaton_node *node = automaton->nodes[i];
-		
-		//check to see if there is any reason to keep the current node
-		if(node->identifier == automaton->starting_state){continue;}
-		if(node->is_ending_state){continue;}
-		if(node->n_transitions != 1){
-			if(node->n_transitions == 0){
-				//check to see if there are any inbound transitions
-				int empty = 1;
-				for(j = 0; j < automaton->n_nodes; j++){
-					struct automaton_node *from_node = automaton->nodes[j];
-					for(k = 0; k < from_node->n_transitions; k++){
-						struct automaton_transition *t = from_node->transitions[k];
-						if(t->identifier == node->identifier){
-							empty = 0;
-						}
-					}
-				}
-				if(empty){
-					//remove the empty node
-					node->n_transitions = -1;
-				}
-			}
+	int n = automaton->n_nodes;
+	int *redirect = malloc(n * sizeof(int));
+	int *stack = malloc(n * sizeof(int));
+	resolve_redirects(automaton, redirect, stack);
+	free(stack);
+	
+	//count inbound transitions of kept nodes, once rerouted
+	int *n_inbound = calloc(n, sizeof(int));
+	int i, j;
+	for(i = 0; i < n; i++){
+		if(redirect[i] != i){
 			continue;
 		}
-		if(!node->transitions[0]->is_epsilon){continue;}
-		
-		//if we get this far, we need to remove node
-		int divert = node->transitions[0]->identifier;
-		free(node->transitions[0]);
-		free(node->transitions);
-		node->transitions = NULL;
-		node->n_transitions = -1;
-		
-		//look for transitions to this node to divert
-		for(j = 0; j < automaton->n_nodes; j++){
-			struct automaton_node *from_node = automaton->nodes[j];
-			for(k = 0; k < from_node->n_transitions; k++){
-				struct automaton_transition *t = from_node->transitions[k];
-				if(t->identifier == node->identifier){
-					t->identifier = divert;
-				}
-			}
+		struct automaton_node *node = automaton->nodes[i];
+		for(j = 0; j < node->n_transitions; j++){
+			n_inbound[redirect[node->transitions[j]->identifier]]++;
 		}
 	}
 	
 	/*
-	 * At this point, all of the rerouting has been done.  Now, we need to make
-	 * a new automaton with fewer nodes, but the same structure.
+	 * Now determine which nodes will carry over: the kept nodes, except for
+	 * ordinary nodes without any transitions in or out.
 	 */
-	//first determine which nodes will carry over
-	int *new_identifiers = malloc(automaton->n_nodes * sizeof(int));
+	int *new_identifiers = malloc(n * sizeof(int));
 	int node_counter = 0;
-	for(i = 0; i < automaton->n_nodes; i++){
+	int new_start = 0;
+	for(i = 0; i < n; i++){
 		struct automaton_node *node = automaton->nodes[i];
+		int removed = redirect[i] != i;
+		if(!removed && node->n_transitions == 0 && n_inbound[i] == 0){
+			removed = i != automaton->starting_state && !node->is_ending_state;
+		}
 		
-		if(node->n_transitions < 0){
-			//will be removed
+		if(removed){
 			new_identifiers[i] = -1;
 		}else{
-			//will not be removed
+			if(i == automaton->starting_state){
+				new_start = node_counter;
+			}
 			new_identifiers[i] = node_counter;
 			node_counter++;
 		}
 	}
+	free(n_inbound);
 	
-	//Create and populate new automaton
-	int newsize = node_counter;
-	FiniteAutomaton *reduced = create_automaton_empty(newsize);
-	reduced->starting_state = new_identifiers[automaton->starting_state];
-	
-	//migrate transitions and endstates
-	for(i = 0; i < automaton->n_nodes; i++){
-		struct automaton_node *old_node, *new_node;
-		old_node = automaton->nodes[i];
+	/*
+	 * Compact the node array in place: each kept node moves down to its new
+	 * identifier (never above its old one) and its transitions are rerouted
+	 * where they are.  Removed nodes stay in the arena until it is freed.
+	 */
+	for(i = 0; i < n; i++){
 		if(new_identifiers[i] < 0){
-			//removed node
 			continue;
 		}
-		new_node = reduced->nodes[new_identifiers[i]];
-		new_node->is_ending_state = old_node->is_ending_state;
-		
-		//transitions
-		new_node->n_transitions = old_node->n_transitions;
-		new_node->transitions = malloc(new_node->n_transitions * 
-		                     sizeof(struct automaton_transition*));
-		for(j = 0; j < old_node->n_transitions; j++){
-			struct automaton_transition *old_transition, *new_transition;
-			old_transition = old_node->transitions[j];
-			new_transition = malloc(sizeof(struct automaton_transition));
-			
-			*new_transition = *old_transition;
-			new_transition->identifier = new_identifiers[old_transition->identifier];
-			
-			new_node->transitions[j] = new_transition;
+		struct automaton_node *node = automaton->nodes[i];
+		node->identifier = new_identifiers[i];
+		for(j = 0; j < node->n_transitions; j++){
+			struct automaton_transition *transition = node->transitions[j];
+			transition->identifier =
+				new_identifiers[redirect[transition->identifier]];
 		}
+		automaton->nodes[node->identifier] = node;
 	}
-	
-	
-	
-	//clean up and replace
-	delete_nodes(automaton->nodes, automaton->n_nodes);
+	automaton->n_nodes = node_counter;
+	automaton->starting_state = new_start;
+	
+	//the layouts made from the old numbering are stale
+	delete_compiled_automaton(automaton->compiled);
+	delete_automaton_graph(automaton->graph);
+	delete_bit_parallel_automaton(automaton->simulator);
+	automaton->compiled = NULL;
+	automaton->graph = NULL;
+	automaton->simulator = NULL;
+	
+	free(redirect);
 	free(new_identifiers);
-	*automaton = *reduced;
-	free(reduced);
 }
 
 
@@ -279,18 +380,25 @@ FiniteAutomaton *create_automaton_char(char c){
 	 * Creates a simple finite automaton for just a char; succeeds iff the
 	 * provided char matches c.
 	 */
+	return create_automaton_range(c, c);
+}
+
+
+FiniteAutomaton *create_automaton_range(char low, char high){
+	/**
+	 * Creates a simple finite automaton for a range of chars; succeeds iff the
+	 * provided char is from low up to and including high (as unsigned bytes).
+	 */
 	FiniteAutomaton *automaton = create_automaton_empty(2);
 	
-	//make transition
-	struct automaton_transition *transition = malloc(sizeof(struct automaton_transition));
-	transition->condition = c;
-	transition->identifier = 1; //links to node 1.
-	
 	//link transition to starting node
 	struct automaton_node *node = automaton->nodes[0];
-	node->n_transitions = 1;
-	node->transitions = malloc(1*sizeof(struct automaton_transition*));
-	node->transitions[0] = transition;
+	struct automaton_transition *transition;
+	transition = allocate_transitions(automaton, node, 1);
+	transition->is_epsilon = 0;
+	transition->low = low;
+	transition->high = high;
+	transition->identifier = 1; //links to node 1.
 	
 	//set ending state
 	automaton->nodes[1]->is_ending_state = 1;
@@ -299,187 +407,173 @@ FiniteAutomaton *create_automaton_char(char c){
 }
 
 
-FiniteAutomaton *create_automaton_alternation(FiniteAutomaton *a1in, FiniteAutomaton *a2in){
+FiniteAutomaton *create_automaton_alternation_move(FiniteAutomaton *a1,
+                                                  FiniteAutomaton *a2){
 	/**
-	 * Creates a finite automaton using alternation on a1 and a2.
+	 * Creates a finite automaton using alternation on a1 and a2, which are
+	 * consumed: their nodes are moved into the result rather than copied.
 	 */
-	FiniteAutomaton *a1, *a2;
-	a1 = copy_automaton(a1in);
-	a2 = copy_automaton(a2in);
-	
 	if(a1 == a2){
 		return a1;
 	}
-	//first encapsulate, so we can combine
-	encapsulate(a1);
-	encapsulate(a2);
+	int n1 = a1->n_nodes;
+	int n2 = a2->n_nodes;
+	int newsize = 2 + n1 + n2;
+	FiniteAutomaton *automaton = create_automaton_shell(newsize);
 	
-	//make new automaton
-	int newsize = 2 + a1->n_nodes + a2->n_nodes;
-	FiniteAutomaton *automaton = create_automaton_empty(newsize);
-	
-	//new start node
-	struct automaton_node *start = automaton->nodes[0];
-	start->n_transitions = 2;
-	start->transitions = malloc(2*sizeof(struct automaton_transition*));
-	
-	//transitions from start node
-	struct automaton_transition *t1, *t2;
-	t1 = malloc(sizeof(struct automaton_transition));
-	t2 = malloc(sizeof(struct automaton_transition));
-	t1->is_epsilon = 1;
-	t2->is_epsilon = 1;
-	t1->identifier = 1;
-	t2->identifier = 1 + a1->n_nodes;
-	start->transitions[0] = t1;
-	start->transitions[1] = t2;
-	
-	//copy in nodes
-	copy_nodes(a1->nodes, automaton->nodes, a1->n_nodes, 1);
-	copy_nodes(a2->nodes, automaton->nodes, a2->n_nodes, 1 + a1->n_nodes);
-	
-	//take care of ending states
-	struct automaton_node *end, *e1, *e2;
-	end = automaton->nodes[newsize - 1];
-	e1 = automaton->nodes[a1->n_nodes];
-	e2 = automaton->nodes[newsize - 2];
-	
-	e1->is_ending_state = 0;
-	e2->is_ending_state = 0;
+	//new start node, with transitions to both starts
+	struct automaton_node *start = create_node(automaton, 0);
+	struct automaton_transition *t;
+	t = allocate_transitions(automaton, start, 2);
+	t[0].is_epsilon = 1;
+	t[1].is_epsilon = 1;
+	t[0].identifier = 1 + a1->starting_state;
+	t[1].identifier = 1 + n1 + a2->starting_state;
+	
+	//new single ending state
+	struct automaton_node *end = create_node(automaton, newsize - 1);
 	end->is_ending_state = 1;
 	
-	//new transitions to end
-	t1 = malloc(sizeof(struct automaton_transition));
-	t2 = malloc(sizeof(struct automaton_transition));
-	t1->is_epsilon = 1;
-	t2->is_epsilon = 1;
-	t1->identifier = end->identifier;
-	t2->identifier = end->identifier;
-	
-	//add transitions
-	e1->n_transitions = 1;
-	e2->n_transitions = 1;
-	e1->transitions = malloc(1*sizeof(struct automaton_transition*));
-	e2->transitions = malloc(1*sizeof(struct automaton_transition*));
-	e1->transitions[0] = t1;
-	e2->transitions[0] = t2;
-	
-	
-	delete_automaton(a1);
-	delete_automaton(a2);
-	reduce(automaton);
+	//move in nodes, and send their ending states to the new end
+	splice_nodes(automaton, a1, 1);
+	splice_nodes(automaton, a2, 1 + n1);
+	redirect_endings(automaton, 1, newsize - 1, end->identifier);
+	
+	reduce_automaton(automaton);
 	return automaton;
 }
 
 
-FiniteAutomaton *create_automaton_concatenation(FiniteAutomaton *a1in,
-                                                FiniteAutomaton *a2in){
+FiniteAutomaton *create_automaton_concatenation_move(FiniteAutomaton *a1,
+                                                    FiniteAutomaton *a2){
 	/**
-	 * Creates a finite automaton by concatenating the two finite automata
-	 * provided.
+	 * Creates a finite automaton by concatenating a1 and a2, which are
+	 * consumed: their nodes are moved into the result rather than copied.
 	 */
-	FiniteAutomaton *a1, *a2;
-	a1 = copy_automaton(a1in);
-	a2 = copy_automaton(a2in);
-	
-	//encapsulate so we can combine
-	encapsulate(a1);
-	encapsulate(a2);
-	
-	//make new automaton
-	int newsize = a1->n_nodes + a2->n_nodes;
-	FiniteAutomaton *automaton = create_automaton_empty(newsize);
-	
-	//copy in nodes
-	copy_nodes(a1->nodes, automaton->nodes, a1->n_nodes, 0);
-	copy_nodes(a2->nodes, automaton->nodes, a2->n_nodes, a1->n_nodes);
+	if(a1 == a2){
+		a2 = copy_automaton(a1);
+	}
+	int n1 = a1->n_nodes;
+	int n2 = a2->n_nodes;
+	int newsize = n1 + n2 + 1;
+	FiniteAutomaton *automaton = create_automaton_shell(newsize);
+	automaton->starting_state = a1->starting_state;
+	int second_start = n1 + a2->starting_state;
+	
+	//new single ending state
+	struct automaton_node *end = create_node(automaton, newsize - 1);
+	end->is_ending_state = 1;
 	
-	//transition nodes
-	struct automaton_node *e, *s;
-	e = automaton->nodes[a1->n_nodes - 1];
-	s = automaton->nodes[a1->n_nodes];
-	e->is_ending_state = 0;
+	//move in nodes; a1 ends where a2 starts, and a2 ends at the new end
+	splice_nodes(automaton, a1, 0);
+	splice_nodes(automaton, a2, n1);
+	redirect_endings(automaton, 0, n1, second_start);
+	redirect_endings(automaton, n1, n1 + n2, end->identifier);
 	
-	//make transition
-	struct automaton_transition *t;
-	t = malloc(sizeof(struct automaton_transition));
-	t->is_epsilon = 1;
-	t->identifier = s->identifier;
+	reduce_automaton(automaton);
+	return automaton;
+}
+
+
+FiniteAutomaton *create_automaton_iteration_move(FiniteAutomaton *a){
+	/**
+	 * Create a finite automaton by iterating on the provided automaton, which
+	 * is consumed: its nodes are moved into the result rather than copied.
+	 * The new starting node doubles as the loop node; the old start cannot be
+	 * used for it, since a loop inside a may lead back there mid-match.
+	 */
+	int n = a->n_nodes;
+	int newsize = n + 2;
+	FiniteAutomaton *automaton = create_automaton_shell(newsize);
+	automaton->starting_state = n;
+	int old_start = a->starting_state;
+	
+	//new start (and loop) node, and new single ending state
+	struct automaton_node *start = create_node(automaton, n);
+	struct automaton_node *end = create_node(automaton, n + 1);
+	end->is_ending_state = 1;
 	
-	//add transition
-	e->n_transitions = 1;
-	e->transitions = malloc(1*sizeof(struct automaton_transition*));
-	e->transitions[0] = t;
+	//move in nodes, and send their ending states back to the start
+	splice_nodes(automaton, a, 0);
+	redirect_endings(automaton, 0, n, start->identifier);
 	
+	//enter a, or finish
+	add_epsilon(automaton, start, old_start);
+	add_epsilon(automaton, start, end->identifier);
 	
-	delete_automaton(a1);
-	delete_automaton(a2);
-	reduce(automaton);
+	reduce_automaton(automaton);
 	return automaton;
 }
 
 
-FiniteAutomaton *create_automaton_iteration(FiniteAutomaton *ain){
+FiniteAutomaton *create_automaton_alternation(FiniteAutomaton *a1,
+                                             FiniteAutomaton *a2){
 	/**
-	 * Create a finite automaton by interating on the provided the automaton
+	 * Creates a finite automaton using alternation on a1 and a2.  The
+	 * provided automata are left alone.
 	 */
-	FiniteAutomaton *a = copy_automaton(ain);
-	
-	encapsulate(a);
-	
-	//make new automaton with extra end state
-	int newsize = a->n_nodes + 1;
+	if(a1 == a2){
+		return copy_automaton(a1);
+	}
+	return create_automaton_alternation_move(copy_automaton(a1),
+	                                         copy_automaton(a2));
+}
+
+
+FiniteAutomaton *create_automaton_concatenation(FiniteAutomaton *a1,
+                                                FiniteAutomaton *a2){
+	/**
+	 * Creates a finite automaton by concatenating the two finite automata
+	 * provided.  The provided automata are left alone.
+	 */
+	return create_automaton_concatenation_move(copy_automaton(a1),
+	                                           copy_automaton(a2));
+}
+
+
+FiniteAutomaton *create_automaton_iteration(FiniteAutomaton *a){
+	/**
+	 * Create a finite automaton by iterating on the provided automaton.  The
+	 * provided automaton is left alone.
+	 */
+	return create_automaton_iteration_move(copy_automaton(a));
+}
+
+
+FiniteAutomaton *create_automaton_union(FiniteAutomaton **automata, int n){
+	/**
+	 * Creates a finite automaton accepting anything accepted by one of the n
+	 * provided automata, using a new starting node with an epsilon transition
+	 * to the start of each.  Unlike alternation, the ending nodes of every
+	 * automaton are kept, and those of automata[i] are given token i.
+	 */
+	int i, j;
+	int newsize = 1;
+	for(i = 0; i < n; i++){
+		newsize += automata[i]->n_nodes;
+	}
 	FiniteAutomaton *automaton = create_automaton_empty(newsize);
 	
-	//copy in nodes
-	copy_nodes(a->nodes, automaton->nodes, a->n_nodes, 0);
-	
-	//new and old end nodes and start node
-	struct automaton_node *e, *end, *start;
-	start = automaton->nodes[0];
-	e = automaton->nodes[newsize - 2];
-	end = automaton->nodes[newsize - 1];
-	
-	e->is_ending_state = 0;
-	end->is_ending_state = 1;
-	
-	//make transitions
-	struct automaton_transition *tforward, *tback, *tfinish;
-	tforward = malloc(sizeof(struct automaton_transition));
-	tback = malloc(sizeof(struct automaton_transition));
-	tfinish = malloc(sizeof(struct automaton_transition));
-	tforward->is_epsilon = 1;
-	tback->is_epsilon = 1;
-	tfinish->is_epsilon = 1;
-	tforward->identifier = end->identifier;
-	tback->identifier = start->identifier;
-	tfinish->identifier = end->identifier;
-	
-	//forward transition
-	start->n_transitions++;
-	int m = start->n_transitions;
-	struct automaton_transition **new_transitions;
-	new_transitions = malloc(m*sizeof(struct automaton_transition*));
+	//new start node
+	struct automaton_node *start = automaton->nodes[0];
+	struct automaton_transition *t = allocate_transitions(automaton, start, n);
 	
-	//copy existing start transitions and set new forward transition
-	int i;
-	for(i = 0; i < m-1; i++){
-		new_transitions[i] = start->transitions[i];
+	//copy in nodes and link them to the start
+	int offset = 1;
+	for(i = 0; i < n; i++){
+		copy_nodes(automaton, automata[i]->nodes, automata[i]->n_nodes, offset);
+		for(j = offset; j < offset + automata[i]->n_nodes; j++){
+			if(automaton->nodes[j]->is_ending_state){
+				automaton->nodes[j]->token = i;
+			}
+		}
+		
+		t[i].is_epsilon = 1;
+		t[i].identifier = offset + automata[i]->starting_state;
+		
+		offset += automata[i]->n_nodes;
 	}
-	new_transitions[m - 1] = tforward;
-	
-	//reset start transitions
-	free(start->transitions);
-	start->transitions = new_transitions;
 	
-	//set other transitions
-	e->n_transitions = 2;
-	e->transitions = malloc(2*sizeof(struct automaton_transition*));
-	e->transitions[0] = tback;
-	e->transitions[1] = tfinish;
-	
-	delete_automaton(a);
-	reduce(automaton);
 	return automaton;
 }
 
@@ -490,10 +584,12 @@ FiniteAutomaton *copy_automaton(FiniteAutomaton *original){
 	 * Creates and returns a pointer to a deep copy of the provided finite
 	 * automaton.
 	 */
+	AUTOMATON_STATS_ADD(automata_copied, 1);
 	FiniteAutomaton *copy = create_automaton_empty(original->n_nodes);
+	copy->starting_state = original->starting_state;
 	
 	//deep copy of all nodes
-	copy_nodes(original->nodes, copy->nodes, original->n_nodes, 0);
+	copy_nodes(copy, original->nodes, original->n_nodes, 0);
 	
 	return copy;
 }
@@ -532,8 +628,10 @@ void print_automaton(FiniteAutomaton *automaton){
 			struct automaton_transition *t = node->transitions[j];
 			if(t->is_epsilon){
 				printf(" <eps,%2d>", t->identifier);
+			}else if(t->low == t->high){
+				printf(" <'%c',%2d>", t->low, t->identifier);
 			}else{
-				printf(" <'%c',%2d>", t->condition, t->identifier);
+				printf(" <'%c'-'%c',%2d>", t->low, t->high, t->identifier);
 			}
 		}
 		
@@ -549,9 +647,12 @@ void delete_automaton(FiniteAutomaton *automaton){
 	/**
 	 * Frees all memory associated with the specified automaton
 	 */
-	
-	delete_nodes(automaton->nodes, automaton->n_nodes);
-	free(automaton->lookup_table);
-	free(automaton->transition_chars);
+	if(automaton == NULL){
+		return;
+	}
+	delete_arena(automaton->arena);
+	delete_compiled_automaton(automaton->compiled);
+	delete_automaton_graph(automaton->graph);
+	delete_bit_parallel_automaton(automaton->simulator);
 	free(automaton);
 }
@@ -1,10 +1,13 @@
 /**
  * Contains data structures necessary for finite automata
  */
+#include <stdint.h>
+#include <stdio.h>
 
 struct automaton_transition{
 	int is_epsilon; //indicates if the state is an epsilon
-	char condition; //transition is valid if a character matches this
+	unsigned char low; //transition is valid for characters from low
+	unsigned char high; //up to and including high
 	int identifier; //identifier of the node to which this transition goes
 };
 
@@ -12,41 +15,455 @@ struct automaton_node {
 	int identifier;
 	int n_transitions;
 	int is_ending_state; //either zero or one
+	int token; //reported when ending; lower tokens win in deterministic states
 	struct automaton_transition **transitions;//must be of length n_transitions
 };
 
+typedef struct compiled_automaton {
+	/**
+	 * Table-driven form of a deterministic finite automaton.  Every byte is
+	 * mapped to a column (its class), and the next state from state s on byte
+	 * c is table[s * n_classes + classes[c]].  State zero is a dead state: it
+	 * never accepts and every column leads back to it, so a missing transition
+	 * needs no special case.  Entries are as narrow as the number of states
+	 * allows (uint8_t, uint16_t or uint32_t), so small tables stay in cache.
+	 */
+	int n_states;
+	int n_classes;
+	int starting_state;
+	int state_size; //bytes per table entry: 1, 2 or 4
+	unsigned char classes[256]; //class (table column) of each byte
+	void *table; //n_states rows of n_classes next states
+	unsigned char *accepting; //one if the state accepts, else zero
+	int *tokens; //token of each accepting state, -1 for the others
+	
+	//file the tables live in if loaded with load_compiled_automaton, or NULL
+	void *mapping;
+	unsigned long mapping_size;
+} CompiledAutomaton;
+
+#define COMPILED_DEAD_STATE 0
+
+typedef struct automaton_stream {
+	/**
+	 * Progress of a match whose input arrives in chunks.  The caller owns the
+	 * structure (it may live on the stack); feeding it allocates nothing and
+	 * does not keep any of the input.
+	 */
+	CompiledAutomaton *compiled;
+	int state; //current compiled state
+	long offset; //number of bytes fed so far
+	long last_accept; //bytes fed when last in an accepting state, or -1
+} AutomatonStream;
+
+typedef struct tokenizer {
+	/**
+	 * Several token automata merged into a single deterministic automaton.
+	 * Its states report ranks, where a lower rank is a higher priority, and
+	 * token_ids maps each rank back to the token's identifier.
+	 */
+	CompiledAutomaton *compiled;
+	int n_tokens;
+	int *token_ids; //identifier of the token with each rank
+} Tokenizer;
+
+struct token {
+	int token_id; //index of the automaton which matched
+	int offset; //position of the first byte in the input
+	int length; //number of bytes matched
+};
+
+typedef struct pattern_set {
+	/**
+	 * Several patterns merged into a single deterministic automaton, so one
+	 * pass over the input finds every pattern which matches it.  The token of
+	 * each accepting state indexes sets, which holds the bitset of patterns
+	 * (by identifier) accepting in that state.
+	 */
+	CompiledAutomaton *compiled;
+	int n_patterns;
+	int n_words; //words per set of patterns
+	int n_sets;
+	uint64_t *sets; //n_sets distinct sets, n_words each
+} PatternSet;
+
+#define SEARCHER_MAX_PREFIX 32
+
+typedef struct searcher {
+	/**
+	 * Finds matches of a pattern anywhere in a buffer.  The unanchored
+	 * automaton accepts any input ending with a match, the reversed one the
+	 * reverse of any input starting with a match, and the anchored one is the
+	 * pattern itself.  Bytes which cannot start a match are skipped without
+	 * running the unanchored automaton.
+	 */
+	CompiledAutomaton *anchored;
+	CompiledAutomaton *unanchored;
+	CompiledAutomaton *reversed;
+	unsigned char can_start[256]; //one if a match can start with the byte
+	int n_first; //number of such bytes (256 if matches may be empty)
+	unsigned char first[256]; //the first n_first of them
+	unsigned char prefix[SEARCHER_MAX_PREFIX]; //literal starting every match
+	int prefix_length;
+} Searcher;
+
+typedef struct automaton_graph {
+	/**
+	 * Compressed sparse row layout of an automaton's transitions.  The
+	 * character transitions of node i are entries offsets[i] up to
+	 * offsets[i + 1] of targets, low and high, and its epsilon transitions
+	 * are entries epsilon_offsets[i] up to epsilon_offsets[i + 1] of
+	 * epsilon_targets, so walking a node's edges touches contiguous memory.
+	 */
+	int n_nodes;
+	int starting_state;
+	int n_transitions;
+	int n_epsilon;
+	int *offsets; //n_nodes + 1 entries
+	int *targets;
+	unsigned char *low; //first character of each transition's range
+	unsigned char *high; //last character of each transition's range
+	int *epsilon_offsets; //n_nodes + 1 entries
+	int *epsilon_targets;
+	unsigned char *ending; //one if the node is an ending state, else zero
+	int *tokens;
+	
+	//epsilon closure data (computed on demand, see automata_closure.c)
+	uint64_t *closures; //bitset closure of each node, in node order
+	uint64_t *important; //nodes with non-epsilon transitions or ending states
+} AutomatonGraph;
+
+typedef struct bit_parallel_automaton {
+	/**
+	 * Glushkov form of an automaton, for simulating it without making it
+	 * deterministic (see automata_bitparallel.c).  Each character transition
+	 * is a position, identified by its index in the automaton's graph.  The
+	 * active set D holds the positions taken by the last byte read, and
+	 * reading byte c moves it to follow(D) & masks[classes[c]], where
+	 * follow(D) is the union of reach[targets[p]] over the positions p in D.
+	 */
+	int n_positions;
+	int n_words; //words per set of positions
+	int n_classes;
+	unsigned char classes[256]; //class of each byte
+	uint64_t *masks; //positions matching each class
+	uint64_t *reach; //positions leaving the closure of each node
+	int *targets; //node each position leads to
+	uint64_t *initial; //positions leaving the closure of the starting node
+	uint64_t *final; //positions after which the automaton accepts
+	int accepts_empty; //whether the empty string is accepted
+	
+	//with at most 64 positions: the follow set of each byte of a set, or NULL
+	uint64_t *chunks;
+} BitParallelAutomaton;
+
+typedef struct lazy_automaton {
+	/**
+	 * Deterministic automaton whose states are sets of nodes of another
+	 * automaton, made only once the input reaches them (see automata_lazy.c).
+	 * Rows of the table start out as LAZY_UNKNOWN and are filled in as
+	 * transitions are taken.  Once max_states are cached, every state is
+	 * thrown away and the cache starts over.
+	 */
+	struct automaton_graph *graph; //owned copy of the automaton's transitions
+	int n_classes;
+	unsigned char classes[256]; //class (table column) of each byte
+	unsigned char representatives[256]; //one byte of each class
+	struct hash_table *states; //set of nodes of each cached state
+	int max_states;
+	int capacity; //number of rows allocated
+	int *table; //next state for each cached state and class
+	unsigned char *accepting; //one if the state accepts, else zero
+	int starting_state;
+	long n_flushes; //number of times the cache has been emptied
+	
+	//scratch sets of nodes
+	uint64_t *starting_set;
+	uint64_t *current;
+	uint64_t *moves;
+} LazyAutomaton;
+
+#define LAZY_DEAD_STATE 0
+#define LAZY_UNKNOWN -1
+
 typedef struct finite_automaton {
 	/**
 	 * Data structure representing finite automaton.  Contains 
-	 * a fixed number of nodes and a lookup table for fast reference.  Each node
+	 * a fixed number of nodes and a compiled table for fast reference.  Each node
 	 * is identified by a number starting with zero.
 	 */
 	 int n_nodes;
 	 int starting_state; //identifier for the starting state
 	 struct automaton_node **nodes;
-	 
-	 //lookup table data (only applicable for deterministic automata)
-	 int *lookup_table;
-	 char *transition_chars;
-	 int n_transition_chars;
+	 struct arena *arena; //owns the nodes and transitions (see arena.h)
+	
+	 //compiled table (only applicable for deterministic automata)
+	 CompiledAutomaton *compiled;
+	
+	 //flat layout of the transitions (made on demand, see automata_graph.c)
+	 AutomatonGraph *graph;
+	
+	 //simulator for nondeterministic automata (see automata_bitparallel.c)
+	 BitParallelAutomaton *simulator;
 } FiniteAutomaton;
 
+typedef struct automaton_stats {
+	/**
+	 * Instrumentation counters (see automata_stats.c).  They are only
+	 * updated when the library is built with AUTOMATA_STATS defined.  Every
+	 * field is an unsigned long.
+	 */
+	unsigned long nodes_created;
+	unsigned long transitions_created;
+	unsigned long automata_copied; //calls to copy_automaton
+	unsigned long closures_computed; //calls to graph_close_state
+	unsigned long dfa_states; //deterministic states discovered (lazy included)
+	unsigned long tables_compiled; //calls to compile_automaton
+	unsigned long bytes_matched; //bytes stepped through by every matcher
+	
+	//total nanoseconds spent in each timing span
+	unsigned long regex_ns;
+	unsigned long determinize_ns;
+	unsigned long minimize_ns;
+	unsigned long compile_ns;
+} AutomatonStats;
+
+//called with a span's name and length in nanoseconds as it ends
+typedef void (*AutomatonTraceHook)(const char*, unsigned long);
+
+typedef struct automaton_builder {
+	/**
+	 * Nodes shared by the fragments of an expression under construction.
+	 */
+	struct arena *arena; //owns the nodes and transitions
+	int n_nodes;
+	int capacity;
+	struct automaton_node **nodes;
+} AutomatonBuilder;
+
+struct automaton_fragment {
+	/**
+	 * Part of an automaton within a builder, with a single start node and a
+	 * single end node which has no transitions of its own.
+	 */
+	int start;
+	int end;
+};
+
+/*
+ * Methods for instrumentation counters and timing spans. (automata_stats.c)
+ * The macros cost nothing unless AUTOMATA_STATS is defined.
+ */
+extern AutomatonStats automaton_stats;
+
+unsigned long automaton_stats_clock();
+void automaton_stats_end_span(const char*, unsigned long*, unsigned long);
+void automaton_get_stats(AutomatonStats*);
+void automaton_reset_stats();
+void automaton_set_trace_hook(AutomatonTraceHook);
+
+#ifdef AUTOMATA_STATS
+#define AUTOMATON_STATS_ADD(counter, n) \
+	__atomic_fetch_add(&automaton_stats.counter, (n), __ATOMIC_RELAXED)
+#define AUTOMATON_SPAN_BEGIN(span) \
+	unsigned long span##_span_start = automaton_stats_clock()
+#define AUTOMATON_SPAN_END(span) \
+	automaton_stats_end_span(#span, &automaton_stats.span##_ns, \
+	                         span##_span_start)
+#else
+#define AUTOMATON_STATS_ADD(counter, n) ((void) 0)
+#define AUTOMATON_SPAN_BEGIN(span) ((void) 0)
+#define AUTOMATON_SPAN_END(span) ((void) 0)
+#endif
+
+//test function
+int stats_test();
+
 /*
  * Methods for nondeterministic and deterministic finite automata. (automata.c)
  */
+FiniteAutomaton *create_automaton_empty(int);
+struct automaton_transition *allocate_transitions(FiniteAutomaton*,
+                                                  struct automaton_node*, int);
 FiniteAutomaton *create_automaton_char(char);
+FiniteAutomaton *create_automaton_range(char, char);
 FiniteAutomaton *create_automaton_alternation(FiniteAutomaton*, FiniteAutomaton*);
 FiniteAutomaton *create_automaton_concatenation(FiniteAutomaton*, FiniteAutomaton*);
 FiniteAutomaton *create_automaton_iteration(FiniteAutomaton*);
+FiniteAutomaton *create_automaton_alternation_move(FiniteAutomaton*,
+                                                  FiniteAutomaton*);
+FiniteAutomaton *create_automaton_concatenation_move(FiniteAutomaton*,
+                                                    FiniteAutomaton*);
+FiniteAutomaton *create_automaton_iteration_move(FiniteAutomaton*);
+FiniteAutomaton *create_automaton_union(FiniteAutomaton**, int);
 FiniteAutomaton *copy_automaton(FiniteAutomaton*);
+void reduce_automaton(FiniteAutomaton*);
 void print_automaton(FiniteAutomaton*);
 void delete_automaton(FiniteAutomaton*);
 
+/*
+ * Methods for building automata from whole expressions. (automata_builder.c)
+ */
+AutomatonBuilder *create_automaton_builder();
+struct automaton_fragment automaton_builder_empty(AutomatonBuilder*);
+struct automaton_fragment automaton_builder_char(AutomatonBuilder*, char);
+struct automaton_fragment automaton_builder_set(AutomatonBuilder*, uint64_t*);
+struct automaton_fragment automaton_builder_alternation(AutomatonBuilder*,
+		struct automaton_fragment, struct automaton_fragment);
+struct automaton_fragment automaton_builder_concatenation(AutomatonBuilder*,
+		struct automaton_fragment, struct automaton_fragment);
+struct automaton_fragment automaton_builder_iteration(AutomatonBuilder*,
+		struct automaton_fragment);
+struct automaton_fragment automaton_builder_repetition(AutomatonBuilder*,
+		struct automaton_fragment);
+struct automaton_fragment automaton_builder_optional(AutomatonBuilder*,
+		struct automaton_fragment);
+FiniteAutomaton *automaton_builder_finish(AutomatonBuilder*,
+                                          struct automaton_fragment);
+void delete_automaton_builder(AutomatonBuilder*);
+
+/*
+ * Methods for compiling regular expressions. (automata_regex.c)
+ */
+FiniteAutomaton *automaton_compile_regex(const char*);
+
+//test function
+int regex_test();
+
+/*
+ * Methods for the flat graph layout of automata. (automata_graph.c)
+ */
+AutomatonGraph *create_automaton_graph(FiniteAutomaton*);
+FiniteAutomaton *create_automaton_from_graph(AutomatonGraph*);
+AutomatonGraph *get_automaton_graph(FiniteAutomaton*);
+int automaton_simulate_string(FiniteAutomaton*, char*, int);
+int graph_byte_classes(AutomatonGraph*, unsigned char*, unsigned char*);
+void delete_automaton_graph(AutomatonGraph*);
+
+/*
+ * Methods for epsilon closures of nondeterministic automata. (automata_closure.c)
+ */
+void compute_graph_closures(AutomatonGraph*);
+void graph_close_state(AutomatonGraph*, uint64_t*, uint64_t*);
+
 /*
  * Methods specifically for deterministic finite automata. (deterministic_automata.c)
  */
+#define AUTOMATON_MINIMIZE 0x01 //flag: minimize after determinization
+
 FiniteAutomaton *create_automaton_deterministic(FiniteAutomaton*);
+FiniteAutomaton *create_automaton_deterministic_flags(FiniteAutomaton*, int);
+FiniteAutomaton *create_automaton_deterministic_sets(FiniteAutomaton*, int,
+                                                     struct hash_table*);
+FiniteAutomaton *minimize_automaton(FiniteAutomaton*);
 int automaton_is_deterministic(FiniteAutomaton*);
 int automaton_test_string(FiniteAutomaton*, char*, int);
 
+//test function
+int minimize_test();
+
+/*
+ * Methods for simulating nondeterministic automata. (automata_bitparallel.c)
+ */
+BitParallelAutomaton *create_bit_parallel_automaton(FiniteAutomaton*);
+int bit_parallel_test_string(BitParallelAutomaton*, char*, int);
+BitParallelAutomaton *get_bit_parallel_automaton(FiniteAutomaton*);
+void delete_bit_parallel_automaton(BitParallelAutomaton*);
+
+//test function
+int bit_parallel_test();
+
+/*
+ * Methods for matching from several threads. (automata_batch.c)
+ */
+int automaton_freeze(FiniteAutomaton*);
+int automaton_test_batch(FiniteAutomaton*, char**, int*, int*, int, int);
+void automaton_stop_batch_threads();
+
+//test function
+int batch_test();
+
+/*
+ * Methods for lazily built deterministic automata. (automata_lazy.c)
+ */
+LazyAutomaton *create_lazy_automaton(FiniteAutomaton*, unsigned long);
+int lazy_automaton_test_string(LazyAutomaton*, char*, int);
+int count_lazy_states(LazyAutomaton*);
+void delete_lazy_automaton(LazyAutomaton*);
+
+//test function
+int lazy_test();
+
+/*
+ * Methods for compiled deterministic automata. (automata_compiled.c)
+ */
+CompiledAutomaton *compile_automaton(FiniteAutomaton*);
+int compiled_automaton_run(CompiledAutomaton*, int, char*, int);
+int compiled_automaton_run_longest(CompiledAutomaton*, int, char*, int, int*,
+                                   int*);
+int compiled_automaton_test_string(CompiledAutomaton*, char*, int);
+uint32_t compiled_automaton_entry(CompiledAutomaton*, unsigned long);
+CompiledAutomaton *get_compiled_automaton(FiniteAutomaton*);
+void delete_compiled_automaton(CompiledAutomaton*);
+
+/*
+ * Methods for saving and loading compiled automata. (automata_binary.c)
+ */
+#define COMPILED_BINARY_VERSION 2
+#define COMPILED_LOAD_CHECK 0x01 //flag: check every table entry when loading
+
+int save_compiled_automaton(CompiledAutomaton*, const char*);
+CompiledAutomaton *load_compiled_automaton(const char*);
+CompiledAutomaton *load_compiled_automaton_flags(const char*, int);
+
+//test function
+int binary_test();
+
+/*
+ * Methods for generating C code from deterministic automata. (automata_codegen.c)
+ */
+int generate_automaton_c(FiniteAutomaton*, const char*, FILE*);
+
+/*
+ * Methods for splitting input into tokens. (automata_tokenizer.c)
+ */
+Tokenizer *create_tokenizer(FiniteAutomaton**, int*, int);
+int tokenizer_scan(Tokenizer*, char*, int, struct token*, int, int*);
+void delete_tokenizer(Tokenizer*);
+
+//test function
+int tokenizer_test();
+
+/*
+ * Methods for matching many patterns at once. (automata_patterns.c)
+ */
+PatternSet *create_pattern_set(FiniteAutomaton**, int);
+uint64_t *pattern_set_match_set(PatternSet*, char*, int);
+int pattern_set_match(PatternSet*, char*, int, int*, int);
+void delete_pattern_set(PatternSet*);
+
+//test function
+int pattern_set_test();
+
+/*
+ * Methods for finding matches within input. (automata_search.c)
+ */
+Searcher *create_searcher(FiniteAutomaton*);
+int searcher_find(Searcher*, char*, int, int, struct token*);
+int searcher_find_all(Searcher*, char*, int, struct token*, int);
+void delete_searcher(Searcher*);
+
+//test function
+int search_test();
+
+/*
+ * Methods for matching input fed in chunks. (automata_stream.c)
+ */
+int automaton_stream_begin(AutomatonStream*, FiniteAutomaton*);
+int automaton_stream_feed(AutomatonStream*, char*, int);
+int automaton_stream_end(AutomatonStream*);
+
+//test function
+int stream_test();
+
 
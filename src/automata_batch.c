@@ -0,0 +1,388 @@
+/**
+ * Contains methods for testing many strings against one automaton from
+ * several threads at once.  The strings are split into one contiguous range
+ * per thread; each thread takes small chunks from the front of its own range,
+ * and once it runs out it steals the back half of another thread's range, so
+ * a few long strings cannot hold up the whole batch.  The helper threads are
+ * started by the first batch which needs them and then wait for the next
+ * one, so small batches do not pay for starting threads.  The public methods
+ * are declared in automata.h.
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "automata.h"
+
+
+//number of strings a thread takes from its range at a time
+#define BATCH_CHUNK 32
+#define BATCH_CACHE_LINE 64
+
+//most threads a batch is spread over, the calling thread included
+#define BATCH_MAX_THREADS 64
+
+
+struct batch_worker {
+	/**
+	 * Strings left for one thread, as the index of the next string in the
+	 * low half and the end of the range in the high half, so that the owner
+	 * and thieves can both update it with one compare-and-swap.  Each worker
+	 * has a cache line to itself.
+	 */
+	_Atomic uint64_t range;
+	char padding[BATCH_CACHE_LINE - sizeof(uint64_t)];
+};
+
+struct batch {
+	CompiledAutomaton *compiled; //NULL for nondeterministic automata
+	BitParallelAutomaton *simulator;
+	char **strings;
+	int *lengths;
+	int *results;
+	int n_workers;
+	struct batch_worker *workers;
+};
+
+static struct batch_pool {
+	/**
+	 * Helper threads kept between batches.  Helper k works on range k + 1
+	 * of each batch with more than k + 1 ranges; range 0 belongs to the
+	 * calling thread.  Only one batch uses the pool at a time.
+	 */
+	pthread_mutex_t in_use; //held for the whole of a batch
+	pthread_mutex_t mutex; //guards the rest
+	pthread_cond_t wake; //a batch was posted, or the pool is stopping
+	pthread_cond_t done; //a helper finished its part of the batch
+	pthread_t threads[BATCH_MAX_THREADS];
+	int n_threads;
+	struct batch *batch;
+	unsigned long generation; //number of batches posted
+	int n_finished; //helpers done with the current batch
+	int stopping;
+} pool = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+};
+
+
+static uint64_t pack_range(uint32_t first, uint32_t last){
+	/**
+	 * Packs the range of strings from first up to (but excluding) last.
+	 */
+	return ((uint64_t) last << 32) | first;
+}
+
+
+static int take_chunk(struct batch_worker *worker, int *first, int *last){
+	/**
+	 * Takes up to BATCH_CHUNK strings from the front of the worker's range.
+	 * Returns 0 if the range is empty.
+	 */
+	uint64_t range = atomic_load(&worker->range);
+	while(1){
+		uint32_t begin = range & 0xffffffff;
+		uint32_t end = range >> 32;
+		if(begin >= end){
+			return 0;
+		}
+		uint32_t take = end - begin < BATCH_CHUNK ? end - begin : BATCH_CHUNK;
+		if(atomic_compare_exchange_weak(&worker->range, &range,
+		                                pack_range(begin + take, end))){
+			*first = begin;
+			*last = begin + take;
+			return 1;
+		}
+	}
+}
+
+
+static int steal_work(struct batch *batch, int self){
+	/**
+	 * Moves the back half of some other worker's range into the (empty)
+	 * range of worker self.  Returns 0 if every other range is empty.
+	 */
+	int i;
+	for(i = 1; i < batch->n_workers; i++){
+		int index = (self + i) % batch->n_workers;
+		struct batch_worker *victim = batch->workers + index;
+		uint64_t range = atomic_load(&victim->range);
+		while(1){
+			uint32_t begin = range & 0xffffffff;
+			uint32_t end = range >> 32;
+			if(begin >= end){
+				break;
+			}
+			uint32_t middle = begin + (end - begin) / 2;
+			if(atomic_compare_exchange_weak(&victim->range, &range,
+			                                pack_range(begin, middle))){
+				atomic_store(&batch->workers[self].range,
+				             pack_range(middle, end));
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+static void run_worker(struct batch *batch, int index){
+	/**
+	 * Tests strings, starting with the range of worker index, until no worker
+	 * has any left.
+	 */
+	struct batch_worker *worker = batch->workers + index;
+	
+	int first, last, i;
+	while(1){
+		if(!take_chunk(worker, &first, &last)){
+			if(!steal_work(batch, index)){
+				break;
+			}
+			continue;
+		}
+		for(i = first; i < last; i++){
+			if(batch->compiled != NULL){
+				batch->results[i] = compiled_automaton_test_string(
+						batch->compiled, batch->strings[i], batch->lengths[i]);
+			}else{
+				batch->results[i] = bit_parallel_test_string(
+						batch->simulator, batch->strings[i], batch->lengths[i]);
+			}
+		}
+	}
+}
+
+
+static void *run_helper(void *argument){
+	/**
+	 * Body of helper thread k of the pool: waits for each batch, and works on
+	 * range k + 1 of it if there is one, until the pool is stopped.
+	 */
+	int index = (int) (long) argument + 1;
+	unsigned long seen = 0;
+	
+	pthread_mutex_lock(&pool.mutex);
+	while(1){
+		while(!pool.stopping && pool.generation == seen){
+			pthread_cond_wait(&pool.wake, &pool.mutex);
+		}
+		if(pool.stopping){
+			break;
+		}
+		seen = pool.generation;
+		
+		//a helper started for a batch may first see the one before it
+		struct batch *batch = pool.batch;
+		if(batch == NULL || index >= batch->n_workers){
+			continue;
+		}
+		
+		pthread_mutex_unlock(&pool.mutex);
+		run_worker(batch, index);
+		pthread_mutex_lock(&pool.mutex);
+		pool.n_finished++;
+		pthread_cond_signal(&pool.done);
+	}
+	pthread_mutex_unlock(&pool.mutex);
+	return NULL;
+}
+
+
+static int grow_pool(int n_helpers){
+	/**
+	 * Starts helper threads until the pool has n_helpers of them, or one
+	 * cannot be started.  Must be called with in_use held.  Returns the
+	 * number of helpers the pool has.
+	 */
+	while(pool.n_threads < n_helpers){
+		if(pthread_create(pool.threads + pool.n_threads, NULL, run_helper,
+		                  (void*) (long) pool.n_threads) != 0){
+			break;
+		}
+		pool.n_threads++;
+	}
+	return pool.n_threads;
+}
+
+
+void automaton_stop_batch_threads(){
+	/**
+	 * Stops the helper threads kept for batches, waiting for any batch in
+	 * progress first.  A later batch starts them again.
+	 */
+	pthread_mutex_lock(&pool.in_use);
+	pthread_mutex_lock(&pool.mutex);
+	pool.stopping = 1;
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.mutex);
+	
+	int i;
+	for(i = 0; i < pool.n_threads; i++){
+		pthread_join(pool.threads[i], NULL);
+	}
+	pool.n_threads = 0;
+	pool.generation = 0;
+	pool.stopping = 0;
+	pthread_mutex_unlock(&pool.in_use);
+}
+
+
+int automaton_freeze(FiniteAutomaton *automaton){
+	/**
+	 * Makes everything automaton_test_string needs for the provided
+	 * automaton: the compiled table of a deterministic automaton, or the
+	 * simulator of a nondeterministic one.  Afterwards testing strings no
+	 * longer modifies the automaton, so several threads may test strings
+	 * against it at once.  The automaton must not be changed while frozen.
+	 * Returns 1 for success and 0 for failure.
+	 */
+	if(automaton == NULL){
+		return 0;
+	}
+	if(automaton_is_deterministic(automaton)){
+		return get_compiled_automaton(automaton) != NULL;
+	}
+	return get_bit_parallel_automaton(automaton) != NULL;
+}
+
+
+int automaton_test_batch(FiniteAutomaton *automaton, char **strings,
+                         int *lengths, int *results, int n, int n_threads){
+	/**
+	 * Tests the n provided strings against the automaton, setting results[i]
+	 * to 1 if strings[i] (of length lengths[i]) is accepted and 0 if not.
+	 * The work is spread over n_threads threads, the calling thread
+	 * included; if n_threads is zero or less, one thread per online
+	 * processor is used.  The other threads come from a pool kept between
+	 * calls, and batches from several threads at once take turns with it.
+	 * The automaton is frozen first.  Returns 1 for success and 0 for
+	 * failure.
+	 */
+	if(n < 0 || !automaton_freeze(automaton)){
+		return 0;
+	}
+	if(n_threads <= 0){
+		n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if(n_threads > n / BATCH_CHUNK){
+		n_threads = n / BATCH_CHUNK;
+	}
+	if(n_threads > BATCH_MAX_THREADS){
+		n_threads = BATCH_MAX_THREADS;
+	}
+	if(n_threads < 1){
+		n_threads = 1;
+	}
+	
+	struct batch batch;
+	batch.compiled = automaton->compiled;
+	batch.simulator = automaton->simulator;
+	batch.strings = strings;
+	batch.lengths = lengths;
+	batch.results = results;
+	batch.n_workers = n_threads;
+	batch.workers = aligned_alloc(BATCH_CACHE_LINE,
+	                              n_threads * sizeof(struct batch_worker));
+	
+	//contiguous ranges of (nearly) equal size
+	int i;
+	for(i = 0; i < n_threads; i++){
+		uint32_t first = (long) n * i / n_threads;
+		uint32_t last = (long) n * (i + 1) / n_threads;
+		atomic_init(&batch.workers[i].range, pack_range(first, last));
+	}
+	if(n_threads == 1){
+		run_worker(&batch, 0);
+		free(batch.workers);
+		return 1;
+	}
+	
+	//ranges without a helper (if one could not be started) are stolen
+	pthread_mutex_lock(&pool.in_use);
+	int n_helpers = grow_pool(n_threads - 1);
+	pthread_mutex_lock(&pool.mutex);
+	pool.batch = &batch;
+	pool.n_finished = 0;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.mutex);
+	
+	run_worker(&batch, 0);
+	
+	int n_expected = n_helpers < n_threads - 1 ? n_helpers : n_threads - 1;
+	pthread_mutex_lock(&pool.mutex);
+	while(pool.n_finished < n_expected){
+		pthread_cond_wait(&pool.done, &pool.mutex);
+	}
+	pool.batch = NULL;
+	pthread_mutex_unlock(&pool.mutex);
+	pthread_mutex_unlock(&pool.in_use);
+	
+	free(batch.workers);
+	return 1;
+}
+
+
+/*
+ * Tests
+ */
+int batch_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Batch Tests:\n\n");
+	
+	FiniteAutomaton *nfa = automaton_compile_regex("(a|b)*a(a|b)(a|b)|c+");
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	
+	//strings of very different lengths, so stealing is needed to balance
+	int n = 10000;
+	char **strings = malloc(n * sizeof(char*));
+	int *lengths = malloc(n * sizeof(int));
+	int *results = malloc(n * sizeof(int));
+	int i, j;
+	srand(1);
+	for(i = 0; i < n; i++){
+		lengths[i] = i % 100 == 0 ? 10000 : rand() % 20;
+		strings[i] = malloc(lengths[i] + 1);
+		for(j = 0; j < lengths[i]; j++){
+			strings[i][j] = "abc"[rand() % 3];
+		}
+	}
+	
+	int failures = 0;
+	FiniteAutomaton *automata[] = {dfa, nfa};
+	int threads[] = {1, 4, 0};
+	int a, t;
+	for(a = 0; a < 2; a++){
+		for(t = 0; t < 3; t++){
+			if(!automaton_test_batch(automata[a], strings, lengths, results, n,
+			                         threads[t])){
+				failures++;
+				continue;
+			}
+			for(i = 0; i < n; i++){
+				if(results[i] != automaton_simulate_string(nfa, strings[i],
+				                                           lengths[i])){
+					failures++;
+				}
+			}
+		}
+	}
+	
+	for(i = 0; i < n; i++){
+		free(strings[i]);
+	}
+	free(strings);
+	free(lengths);
+	free(results);
+	delete_automaton(nfa);
+	delete_automaton(dfa);
+	automaton_stop_batch_threads();
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,402 @@
+/**
+ * Contains methods for saving compiled automata to a binary file, and for
+ * loading them back by mapping the file into memory.  The public methods are
+ * declared in automata.h.
+ *
+ * The file holds a header followed by the byte class map, the transition
+ * table, the accepting flags and the tokens.  Every section is found through
+ * an offset from the start of the file, so the file can be mapped anywhere,
+ * and the table and tokens are aligned so they can be used in place: loading
+ * copies nothing but the header and class map, and processes mapping the same
+ * file share its pages.  Numbers are stored in the byte order of the machine
+ * which wrote the file; a file from a machine with the other byte order is
+ * refused.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "automata.h"
+
+
+#define BINARY_MAGIC "AUTOMATA"
+#define BINARY_BYTE_ORDER 0x01020304
+#define BINARY_ALIGNMENT 64
+
+
+struct binary_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order; //BINARY_BYTE_ORDER as written by the saving machine
+	uint32_t n_states;
+	uint32_t n_classes;
+	uint32_t starting_state;
+	uint32_t state_size; //bytes per table entry: 1, 2 or 4
+	uint64_t classes_offset; //256 bytes
+	uint64_t table_offset; //n_states * n_classes entries of state_size
+	uint64_t accepting_offset; //n_states bytes
+	uint64_t tokens_offset; //n_states int32_t
+	uint64_t size; //of the whole file
+};
+
+
+static uint64_t align_offset(uint64_t offset){
+	/**
+	 * Rounds the offset up to the next multiple of BINARY_ALIGNMENT.
+	 */
+	return (offset + BINARY_ALIGNMENT - 1) & ~(uint64_t) (BINARY_ALIGNMENT - 1);
+}
+
+
+static void layout_header(struct binary_header *header,
+                          CompiledAutomaton *compiled){
+	/**
+	 * Fills in the header for the provided compiled automaton, placing each
+	 * section after the previous one.
+	 */
+	uint64_t n_states = compiled->n_states;
+	uint64_t n_classes = compiled->n_classes;
+	
+	memset(header, 0, sizeof(struct binary_header));
+	memcpy(header->magic, BINARY_MAGIC, 8);
+	header->version = COMPILED_BINARY_VERSION;
+	header->byte_order = BINARY_BYTE_ORDER;
+	header->n_states = n_states;
+	header->n_classes = n_classes;
+	header->starting_state = compiled->starting_state;
+	header->state_size = compiled->state_size;
+	
+	header->classes_offset = align_offset(sizeof(struct binary_header));
+	uint64_t table_size = n_states * n_classes * compiled->state_size;
+	header->table_offset = align_offset(header->classes_offset + 256);
+	header->accepting_offset = align_offset(header->table_offset + table_size);
+	header->tokens_offset = align_offset(header->accepting_offset + n_states);
+	header->size = header->tokens_offset + n_states * sizeof(int32_t);
+}
+
+
+static int write_section(FILE *file, uint64_t offset, void *data,
+                         uint64_t length){
+	/**
+	 * Pads the file with zeros up to the offset, then writes the data.
+	 * Returns 1 for success and 0 for failure.
+	 */
+	long position = ftell(file);
+	while(position >= 0 && (uint64_t) position < offset){
+		if(fputc(0, file) == EOF){
+			return 0;
+		}
+		position++;
+	}
+	return position >= 0 && fwrite(data, 1, length, file) == length;
+}
+
+
+int save_compiled_automaton(CompiledAutomaton *compiled, const char *path){
+	/**
+	 * Writes the provided compiled automaton to the file at path, replacing
+	 * it if it exists.  Returns 1 for success and 0 for failure.
+	 */
+	if(compiled == NULL){
+		return 0;
+	}
+	FILE *file = fopen(path, "wb");
+	if(file == NULL){
+		fprintf(stderr, "Cannot open \"%s\" to save a compiled automaton.\n",
+		        path);
+		return 0;
+	}
+	
+	struct binary_header header;
+	layout_header(&header, compiled);
+	unsigned long n_states = compiled->n_states;
+	unsigned long n_entries = n_states * compiled->n_classes;
+	
+	int success = write_section(file, 0, &header, sizeof(header));
+	success = success && write_section(file, header.classes_offset,
+	                                   compiled->classes, 256);
+	success = success && write_section(file, header.table_offset,
+	                                   compiled->table,
+	                                   n_entries * compiled->state_size);
+	success = success && write_section(file, header.accepting_offset,
+	                                   compiled->accepting, n_states);
+	success = success && write_section(file, header.tokens_offset,
+	                                   compiled->tokens,
+	                                   n_states * sizeof(int32_t));
+	if(fclose(file) != 0){
+		success = 0;
+	}
+	if(!success){
+		fprintf(stderr, "Cannot write compiled automaton to \"%s\".\n", path);
+	}
+	return success;
+}
+
+
+static const char *check_header(struct binary_header *header, uint64_t size){
+	/**
+	 * Checks that the header describes a file of the given size which this
+	 * build can use.  Returns NULL if so, and otherwise the problem.
+	 */
+	if(size < sizeof(struct binary_header) ||
+	   memcmp(header->magic, BINARY_MAGIC, 8) != 0){
+		return "not a compiled automaton";
+	}
+	if(header->byte_order != BINARY_BYTE_ORDER){
+		return "written with a different byte order";
+	}
+	if(header->version != COMPILED_BINARY_VERSION){
+		return "unsupported version";
+	}
+	
+	//sections must be where this build would have put them
+	struct binary_header expected;
+	CompiledAutomaton shape;
+	shape.n_states = header->n_states;
+	shape.n_classes = header->n_classes;
+	shape.starting_state = header->starting_state;
+	shape.state_size = header->state_size;
+	if(header->n_states < 1 || header->n_classes < 1 ||
+	   header->n_classes > 256 || header->starting_state >= header->n_states){
+		return "invalid dimensions";
+	}
+	
+	//entries must be able to hold every state
+	uint64_t max_states = header->state_size == 1 ? 1 << 8 :
+	                      header->state_size == 2 ? 1 << 16 :
+	                      header->state_size == 4 ? 1ULL << 32 : 0;
+	if(header->n_states > max_states){
+		return "invalid state size";
+	}
+	layout_header(&expected, &shape);
+	if(memcmp(header, &expected, sizeof(struct binary_header)) != 0 ||
+	   header->size != size){
+		return "invalid layout";
+	}
+	return NULL;
+}
+
+
+static const char *check_tables(CompiledAutomaton *compiled, int flags){
+	/**
+	 * Checks that every class is in range and, with COMPILED_LOAD_CHECK set,
+	 * that every table entry is too, so that a damaged file cannot make a
+	 * match read outside the tables.  The classes were copied already, but
+	 * checking the entries reads (and faults in) the whole mapped table.
+	 * Returns NULL if so, and otherwise the problem.
+	 */
+	int i;
+	for(i = 0; i < 256; i++){
+		if(compiled->classes[i] >= compiled->n_classes){
+			return "byte class out of range";
+		}
+	}
+	if(!(flags & COMPILED_LOAD_CHECK)){
+		return NULL;
+	}
+	
+	unsigned long n_entries = (unsigned long) compiled->n_states *
+	                          compiled->n_classes;
+	unsigned long j;
+	uint32_t n_states = compiled->n_states;
+	uint32_t bad = 0;
+	for(j = 0; j < n_entries; j++){
+		bad |= compiled_automaton_entry(compiled, j) >= n_states;
+	}
+	if(bad){
+		return "transition out of range";
+	}
+	
+	//the dead state must stay dead
+	for(i = 0; i < compiled->n_classes; i++){
+		if(compiled_automaton_entry(compiled, i) != COMPILED_DEAD_STATE){
+			return "dead state can be left";
+		}
+	}
+	if(compiled->accepting[COMPILED_DEAD_STATE]){
+		return "dead state accepts";
+	}
+	return NULL;
+}
+
+
+CompiledAutomaton *load_compiled_automaton_flags(const char *path,
+                                                 int flags){
+	/**
+	 * Loads a compiled automaton saved with save_compiled_automaton by
+	 * mapping the file read-only.  The tables are used in place, and the
+	 * mapping is released by delete_compiled_automaton.  The header, sizes
+	 * and byte classes are always checked; the table entries only with
+	 * COMPILED_LOAD_CHECK, for files which may have been damaged.  Returns
+	 * NULL if the file cannot be read or is not a valid compiled automaton.
+	 */
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "Cannot open \"%s\" to load a compiled automaton.\n",
+		        path);
+		return NULL;
+	}
+	struct stat info;
+	if(fstat(fd, &info) != 0 ||
+	   info.st_size < (off_t) sizeof(struct binary_header)){
+		fprintf(stderr, "Cannot load \"%s\": not a compiled automaton.\n",
+		        path);
+		close(fd);
+		return NULL;
+	}
+	uint64_t size = info.st_size;
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED){
+		fprintf(stderr, "Cannot map \"%s\".\n", path);
+		return NULL;
+	}
+	
+	struct binary_header *header = mapping;
+	const char *problem = check_header(header, size);
+	CompiledAutomaton *compiled = NULL;
+	if(problem == NULL){
+		unsigned char *base = mapping;
+		compiled = malloc(sizeof(CompiledAutomaton));
+		compiled->n_states = header->n_states;
+		compiled->n_classes = header->n_classes;
+		compiled->starting_state = header->starting_state;
+		compiled->state_size = header->state_size;
+		memcpy(compiled->classes, base + header->classes_offset, 256);
+		compiled->table = base + header->table_offset;
+		compiled->accepting = base + header->accepting_offset;
+		compiled->tokens = (int*) (base + header->tokens_offset);
+		compiled->mapping = mapping;
+		compiled->mapping_size = size;
+		problem = check_tables(compiled, flags);
+	}
+	
+	if(problem != NULL){
+		fprintf(stderr, "Cannot load \"%s\": %s.\n", path, problem);
+		if(compiled != NULL){
+			delete_compiled_automaton(compiled);
+		}else{
+			munmap(mapping, size);
+		}
+		return NULL;
+	}
+	return compiled;
+}
+
+
+CompiledAutomaton *load_compiled_automaton(const char *path){
+	/**
+	 * Loads a compiled automaton without checking its table entries (see
+	 * load_compiled_automaton_flags), so only the pages used are read.
+	 */
+	return load_compiled_automaton_flags(path, 0);
+}
+
+
+/*
+ * Tests
+ */
+int binary_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Binary Format Tests:\n\n");
+	
+	char path[] = "/tmp/automata_binary_testXXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0){
+		printf("Cannot make a temporary file.\n");
+		return 1;
+	}
+	close(fd);
+	
+	FiniteAutomaton *nfa = automaton_compile_regex("[a-z_][a-z0-9_]*|-?[0-9]+");
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	CompiledAutomaton *compiled = get_compiled_automaton(dfa);
+	int failures = 0;
+	
+	if(!save_compiled_automaton(compiled, path)){
+		failures++;
+	}
+	CompiledAutomaton *loaded = load_compiled_automaton(path);
+	if(loaded == NULL){
+		failures++;
+	}else{
+		char *strings[] = {"snake_case", "x1", "-42", "1a", "-", ""};
+		int i;
+		for(i = 0; i < 6; i++){
+			int length = strlen(strings[i]);
+			if(compiled_automaton_test_string(compiled, strings[i], length) !=
+			   compiled_automaton_test_string(loaded, strings[i], length)){
+				failures++;
+			}
+		}
+		delete_compiled_automaton(loaded);
+	}
+	
+	//a table too big for 8-bit entries
+	FiniteAutomaton *wide_nfa = automaton_compile_regex(
+			"(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)");
+	FiniteAutomaton *wide_dfa = create_automaton_deterministic(wide_nfa);
+	CompiledAutomaton *wide = get_compiled_automaton(wide_dfa);
+	loaded = NULL;
+	if(wide->state_size != 2 || !save_compiled_automaton(wide, path) ||
+	   (loaded = load_compiled_automaton(path)) == NULL){
+		failures++;
+	}else{
+		char string[16];
+		int i, j;
+		srand(1);
+		for(i = 0; i < 100; i++){
+			for(j = 0; j < 16; j++){
+				string[j] = 'a' + rand() % 2;
+			}
+			if(compiled_automaton_test_string(loaded, string, 16) !=
+			   automaton_simulate_string(wide_nfa, string, 16)){
+				failures++;
+			}
+		}
+	}
+	delete_compiled_automaton(loaded);
+	delete_automaton(wide_nfa);
+	delete_automaton(wide_dfa);
+	
+	//a transition out of range is only found when asked for
+	struct binary_header header;
+	layout_header(&header, compiled);
+	unsigned char bad_state = 0xff;
+	fd = -1;
+	if(save_compiled_automaton(compiled, path)){
+		fd = open(path, O_WRONLY);
+	}
+	if(fd < 0 || pwrite(fd, &bad_state, 1, header.table_offset +
+	                    compiled->n_classes) != 1){
+		failures++;
+	}else{
+		loaded = load_compiled_automaton(path);
+		if(loaded == NULL ||
+		   load_compiled_automaton_flags(path, COMPILED_LOAD_CHECK) != NULL){
+			failures++;
+		}
+		delete_compiled_automaton(loaded);
+	}
+	if(fd >= 0){
+		close(fd);
+	}
+	
+	//a truncated file is refused
+	if(truncate(path, 100) != 0 || load_compiled_automaton(path) != NULL){
+		failures++;
+	}
+	
+	unlink(path);
+	delete_automaton(nfa);
+	delete_automaton(dfa);
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
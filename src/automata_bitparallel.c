@@ -0,0 +1,296 @@
+/**
+ * Contains methods for simulating nondeterministic finite automata without
+ * making them deterministic, by tracking the set of transitions just taken as
+ * a bitset.  The automaton is treated in its Glushkov (position) form: every
+ * character transition is a position, and reading a byte moves the active
+ * set D to follow(D) & mask(byte).  Building the tables costs time linear in
+ * the size of the automaton and its closures, so this suits patterns which
+ * are only matched a few times.  The public methods are declared in
+ * automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+#include "bitset.h"
+
+
+//automata with at most this many positions keep the active set in one word
+#define BIT_PARALLEL_FAST_POSITIONS 64
+
+//sets of at most this many words are kept on the stack while matching
+#define BIT_PARALLEL_STACK_WORDS 32
+
+
+static void fill_fast_tables(BitParallelAutomaton *simulator){
+	/**
+	 * Fills the tables used when every set fits in one word: for each byte k
+	 * of the active set and each value v of that byte, the union of the
+	 * follow sets of the positions in v.  Each entry extends the entry
+	 * without its lowest bit, so every entry costs a single or.
+	 */
+	int n_chunks = (simulator->n_positions + 7) / 8;
+	simulator->chunks = calloc(n_chunks * 256, sizeof(uint64_t));
+	
+	int k, v;
+	for(k = 0; k < n_chunks; k++){
+		uint64_t *table = simulator->chunks + k * 256;
+		for(v = 1; v < 256; v++){
+			int position = 8 * k + __builtin_ctz(v);
+			table[v] = table[v & (v - 1)];
+			if(position < simulator->n_positions){
+				table[v] |= simulator->reach[simulator->targets[position]];
+			}
+		}
+	}
+}
+
+
+BitParallelAutomaton *create_bit_parallel_automaton(FiniteAutomaton *automaton){
+	/**
+	 * Creates the bit-parallel simulator of the provided automaton, which may
+	 * be nondeterministic.  The simulator keeps its own copy of everything it
+	 * needs, so the automaton may be deleted afterwards.
+	 */
+	if(automaton == NULL){
+		return NULL;
+	}
+	AutomatonGraph *graph = get_automaton_graph(automaton);
+	compute_graph_closures(graph);
+	int n_nodes = graph->n_nodes;
+	int node_words = BITSET_WORDS(n_nodes);
+	int m = graph->n_transitions;
+	int n_words = m > 0 ? BITSET_WORDS(m) : 1;
+	
+	BitParallelAutomaton *simulator = malloc(sizeof(BitParallelAutomaton));
+	simulator->n_positions = m;
+	simulator->n_words = n_words;
+	unsigned char representatives[256];
+	simulator->n_classes = graph_byte_classes(graph, simulator->classes,
+	                                          representatives);
+	
+	//positions leaving the closure of each node
+	simulator->reach = calloc(n_nodes * n_words, sizeof(uint64_t));
+	uint64_t *accepting = create_bitset(n_nodes); //closure has an ending node
+	int v, u, e, k;
+	for(v = 0; v < n_nodes; v++){
+		uint64_t *closure = graph->closures + v * node_words;
+		uint64_t *reach = simulator->reach + v * n_words;
+		for(u = bitset_next(closure, node_words, 0); u >= 0;
+		    u = bitset_next(closure, node_words, u + 1)){
+			for(e = graph->offsets[u]; e < graph->offsets[u + 1]; e++){
+				bitset_set(reach, e);
+			}
+			if(graph->ending[u]){
+				bitset_set(accepting, v);
+			}
+		}
+	}
+	
+	//where each position leads, and whether the automaton accepts there
+	simulator->targets = malloc((m > 0 ? m : 1) * sizeof(int));
+	simulator->final = create_bitset(n_words * 64);
+	for(e = 0; e < m; e++){
+		simulator->targets[e] = graph->targets[e];
+		if(bitset_get(accepting, graph->targets[e])){
+			bitset_set(simulator->final, e);
+		}
+	}
+	
+	simulator->initial = create_bitset(n_words * 64);
+	bitset_copy(simulator->initial,
+	            simulator->reach + graph->starting_state * n_words, n_words);
+	simulator->accepts_empty = bitset_get(accepting, graph->starting_state);
+	free(accepting);
+	
+	//positions matching each byte class
+	simulator->masks = calloc(simulator->n_classes * n_words, sizeof(uint64_t));
+	for(e = 0; e < m; e++){
+		for(k = simulator->classes[graph->low[e]];
+		    k <= simulator->classes[graph->high[e]]; k++){
+			bitset_set(simulator->masks + k * n_words, e);
+		}
+	}
+	
+	simulator->chunks = NULL;
+	if(m <= BIT_PARALLEL_FAST_POSITIONS){
+		fill_fast_tables(simulator);
+	}
+	return simulator;
+}
+
+
+static int test_string_fast(BitParallelAutomaton *simulator,
+                            unsigned char *bytes, int length){
+	/**
+	 * Loop for automata whose sets fit in one word.  The follow set of the
+	 * active set is looked up a byte of it at a time in the chunk tables
+	 * (each entry the union of the follow sets of the positions in that
+	 * byte), and ored together.
+	 */
+	uint64_t *masks = simulator->masks;
+	uint64_t *chunks = simulator->chunks;
+	unsigned char *classes = simulator->classes;
+	int n_chunks = (simulator->n_positions + 7) / 8;
+	
+	uint64_t d = simulator->initial[0] & masks[classes[bytes[0]]];
+	int i, k;
+	for(i = 1; i < length && d != 0; i++){
+		uint64_t follow = 0;
+		for(k = 0; k < n_chunks; k++){
+			follow |= chunks[k * 256 + ((d >> (8 * k)) & 0xff)];
+		}
+		d = follow & masks[classes[bytes[i]]];
+	}
+	AUTOMATON_STATS_ADD(bytes_matched, i);
+	return (d & simulator->final[0]) != 0;
+}
+
+
+static int test_string_general(BitParallelAutomaton *simulator,
+                               unsigned char *bytes, int length){
+	/**
+	 * Loop for automata of any size.  Each step ors together the follow sets
+	 * of the active positions, a word at a time.  The two working sets live
+	 * on the stack unless they are too big for it.
+	 */
+	int n_words = simulator->n_words;
+	uint64_t stack_sets[2 * BIT_PARALLEL_STACK_WORDS];
+	uint64_t *d = stack_sets;
+	if(n_words > BIT_PARALLEL_STACK_WORDS){
+		d = malloc(2 * n_words * sizeof(uint64_t));
+	}
+	uint64_t *follow = d + n_words;
+	
+	bitset_copy(d, simulator->initial, n_words);
+	bitset_intersect(d, simulator->masks + simulator->classes[bytes[0]] * n_words,
+	                 n_words);
+	int i, p;
+	for(i = 1; i < length && !bitset_is_empty(d, n_words); i++){
+		bitset_zero(follow, n_words);
+		for(p = bitset_next(d, n_words, 0); p >= 0;
+		    p = bitset_next(d, n_words, p + 1)){
+			bitset_union(follow,
+			             simulator->reach + simulator->targets[p] * n_words,
+			             n_words);
+		}
+		bitset_intersect(follow,
+		                 simulator->masks + simulator->classes[bytes[i]] * n_words,
+		                 n_words);
+		bitset_copy(d, follow, n_words);
+	}
+	AUTOMATON_STATS_ADD(bytes_matched, i);
+	
+	bitset_intersect(d, simulator->final, n_words);
+	int accepted = !bitset_is_empty(d, n_words);
+	if(d != stack_sets){
+		free(d);
+	}
+	return accepted;
+}
+
+
+int bit_parallel_test_string(BitParallelAutomaton *simulator, char *string,
+                             int length){
+	/**
+	 * Tests the provided string of the specified length against the
+	 * simulator.  The simulator is not modified, so several threads may use
+	 * it at once.  Returns 0 for failure and 1 for success.
+	 */
+	if(length == 0){
+		return simulator->accepts_empty;
+	}
+	if(simulator->chunks != NULL){
+		return test_string_fast(simulator, (unsigned char*) string, length);
+	}
+	return test_string_general(simulator, (unsigned char*) string, length);
+}
+
+
+BitParallelAutomaton *get_bit_parallel_automaton(FiniteAutomaton *automaton){
+	/**
+	 * Returns the bit-parallel simulator of the provided automaton, creating
+	 * it first if that has not been done yet.  The simulator belongs to the
+	 * automaton.
+	 */
+	if(automaton->simulator == NULL){
+		automaton->simulator = create_bit_parallel_automaton(automaton);
+	}
+	return automaton->simulator;
+}
+
+
+void delete_bit_parallel_automaton(BitParallelAutomaton *simulator){
+	/**
+	 * Frees all memory associated with the specified simulator
+	 */
+	if(simulator == NULL){
+		return;
+	}
+	free(simulator->reach);
+	free(simulator->targets);
+	free(simulator->masks);
+	free(simulator->initial);
+	free(simulator->final);
+	free(simulator->chunks);
+	free(simulator);
+}
+
+
+/*
+ * Tests
+ */
+int bit_parallel_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Bit-Parallel Simulation Tests:\n\n");
+	
+	//the last patterns have more than 64 positions, so take the general
+	//loop; the very last has too many to keep its sets on the stack
+	char long_pattern[256] = "(";
+	char huge_pattern[8192] = "";
+	int i, j, k;
+	for(i = 0; i < 25; i++){
+		strcat(long_pattern, "(a|b|c)");
+	}
+	strcat(long_pattern, ")*");
+	for(i = 0; i < 800; i++){
+		strcat(huge_pattern, "(a|b|c)?");
+	}
+	const char *patterns[] = {
+		"(a|b)*a(a|b)(a|b)(a|b)",
+		"(ab|ba)*|a+",
+		"[a-c]*(b|cc)?",
+		"(a*b*)*c",
+		"",
+		long_pattern,
+		huge_pattern,
+	};
+	int n_patterns = sizeof(patterns) / sizeof(patterns[0]);
+	char string[40];
+	int failures = 0;
+	srand(1);
+	
+	for(i = 0; i < n_patterns; i++){
+		FiniteAutomaton *nfa = automaton_compile_regex(patterns[i]);
+		BitParallelAutomaton *simulator = create_bit_parallel_automaton(nfa);
+		for(j = 0; j < 500; j++){
+			int length = rand() % 40;
+			for(k = 0; k < length; k++){
+				string[k] = "abcd"[rand() % 4];
+			}
+			if(bit_parallel_test_string(simulator, string, length) !=
+			   automaton_simulate_string(nfa, string, length)){
+				failures++;
+			}
+		}
+		printf("%d positions\n", simulator->n_positions);
+		delete_bit_parallel_automaton(simulator);
+		delete_automaton(nfa);
+	}
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
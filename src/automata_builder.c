@@ -0,0 +1,298 @@
+/**
+ * Contains methods for building nondeterministic finite automata from whole
+ * expressions.  Every subexpression is a fragment (Thompson's construction)
+ * whose nodes live in one shared builder, so combining fragments only adds a
+ * few nodes and transitions and nothing is ever copied or renumbered.  The
+ * public methods are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "automata.h"
+#include "bitset.h"
+
+
+//size of the blocks of memory builders allocate their nodes from
+#define BUILDER_ARENA_BLOCK_SIZE 4096
+#define BUILDER_INITIAL_CAPACITY 16
+
+
+static int create_builder_node(AutomatonBuilder *builder){
+	/**
+	 * Adds an empty node to the builder and returns its identifier.
+	 */
+	if(builder->n_nodes == builder->capacity){
+		builder->capacity *= 2;
+		builder->nodes = realloc(builder->nodes, builder->capacity *
+		                         sizeof(struct automaton_node*));
+	}
+	
+	struct automaton_node *node;
+	node = arena_alloc(builder->arena, sizeof(struct automaton_node));
+	AUTOMATON_STATS_ADD(nodes_created, 1);
+	node->identifier = builder->n_nodes;
+	node->n_transitions = 0;
+	node->is_ending_state = 0;
+	node->token = 0;
+	node->transitions = NULL;
+	
+	builder->nodes[builder->n_nodes] = node;
+	return builder->n_nodes++;
+}
+
+
+static void add_transition(AutomatonBuilder *builder, int from, int is_epsilon,
+                           unsigned char low, unsigned char high, int to){
+	/**
+	 * Appends a transition between the two nodes.  Fragments' nodes only ever
+	 * have a handful of transitions, so the array is simply regrown.
+	 */
+	struct automaton_node *node = builder->nodes[from];
+	int nt = node->n_transitions + 1;
+	struct automaton_transition **transitions;
+	transitions = arena_alloc(builder->arena,
+	                          nt * sizeof(struct automaton_transition*));
+	
+	int i;
+	for(i = 0; i < nt - 1; i++){
+		transitions[i] = node->transitions[i];
+	}
+	
+	struct automaton_transition *transition;
+	transition = arena_alloc(builder->arena,
+	                         sizeof(struct automaton_transition));
+	transition->is_epsilon = is_epsilon;
+	transition->low = is_epsilon ? 0 : low;
+	transition->high = is_epsilon ? 0 : high;
+	transition->identifier = to;
+	transitions[nt - 1] = transition;
+	AUTOMATON_STATS_ADD(transitions_created, 1);
+	
+	node->n_transitions = nt;
+	node->transitions = transitions;
+}
+
+
+AutomatonBuilder *create_automaton_builder(){
+	/**
+	 * Creates and returns a builder with no fragments.
+	 */
+	AutomatonBuilder *builder = malloc(sizeof(AutomatonBuilder));
+	builder->arena = create_arena(BUILDER_ARENA_BLOCK_SIZE);
+	builder->n_nodes = 0;
+	builder->capacity = BUILDER_INITIAL_CAPACITY;
+	builder->nodes = malloc(builder->capacity * sizeof(struct automaton_node*));
+	
+	return builder;
+}
+
+
+/*
+ * Methods for making fragments.  Each fragment may be used as the operand of
+ * at most one other fragment, since combining fragments links their nodes.
+ */
+
+struct automaton_fragment automaton_builder_empty(AutomatonBuilder *builder){
+	/**
+	 * Makes a fragment matching only the empty string.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = create_builder_node(builder);
+	fragment.end = create_builder_node(builder);
+	add_transition(builder, fragment.start, 1, 0, 0, fragment.end);
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_char(AutomatonBuilder *builder,
+                                                 char c){
+	/**
+	 * Makes a fragment matching just the provided char.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = create_builder_node(builder);
+	fragment.end = create_builder_node(builder);
+	add_transition(builder, fragment.start, 0, c, c, fragment.end);
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_set(AutomatonBuilder *builder,
+                                                uint64_t *set){
+	/**
+	 * Makes a fragment matching any single byte in the provided set (a
+	 * bitset of 256 bits), with one range transition per run of consecutive
+	 * bytes.  An empty set makes a fragment matching nothing.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = create_builder_node(builder);
+	fragment.end = create_builder_node(builder);
+	
+	//one transition per run of consecutive bytes in the set
+	int n_words = BITSET_WORDS(256);
+	int low[128], high[128];
+	int n_runs = 0;
+	int c = bitset_next(set, n_words, 0);
+	while(c >= 0){
+		low[n_runs] = c;
+		while(c < 255 && bitset_get(set, c + 1)){
+			c++;
+		}
+		high[n_runs] = c;
+		n_runs++;
+		c = c < 255 ? bitset_next(set, n_words, c + 1) : -1;
+	}
+	
+	//the start node is new, so all of its transitions can be made at once
+	struct automaton_node *node = builder->nodes[fragment.start];
+	struct automaton_transition *transitions;
+	transitions = arena_alloc(builder->arena,
+	                          n_runs * sizeof(struct automaton_transition));
+	node->transitions = arena_alloc(builder->arena, n_runs *
+	                                sizeof(struct automaton_transition*));
+	node->n_transitions = n_runs;
+	AUTOMATON_STATS_ADD(transitions_created, n_runs);
+	
+	int i;
+	for(i = 0; i < n_runs; i++){
+		transitions[i].is_epsilon = 0;
+		transitions[i].low = low[i];
+		transitions[i].high = high[i];
+		transitions[i].identifier = fragment.end;
+		node->transitions[i] = transitions + i;
+	}
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_alternation(
+		AutomatonBuilder *builder, struct automaton_fragment f1,
+		struct automaton_fragment f2){
+	/**
+	 * Makes a fragment matching anything either f1 or f2 matches.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = create_builder_node(builder);
+	fragment.end = create_builder_node(builder);
+	add_transition(builder, fragment.start, 1, 0, 0, f1.start);
+	add_transition(builder, fragment.start, 1, 0, 0, f2.start);
+	add_transition(builder, f1.end, 1, 0, 0, fragment.end);
+	add_transition(builder, f2.end, 1, 0, 0, fragment.end);
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_concatenation(
+		AutomatonBuilder *builder, struct automaton_fragment f1,
+		struct automaton_fragment f2){
+	/**
+	 * Makes a fragment matching f1 followed by f2.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = f1.start;
+	fragment.end = f2.end;
+	add_transition(builder, f1.end, 1, 0, 0, f2.start);
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_iteration(
+		AutomatonBuilder *builder, struct automaton_fragment f){
+	/**
+	 * Makes a fragment matching any number (including zero) of repetitions
+	 * of f.  The new start node is also the loop node, so f's own start can
+	 * never skip to the end after input has been consumed.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = create_builder_node(builder);
+	fragment.end = create_builder_node(builder);
+	add_transition(builder, fragment.start, 1, 0, 0, f.start);
+	add_transition(builder, fragment.start, 1, 0, 0, fragment.end);
+	add_transition(builder, f.end, 1, 0, 0, fragment.start);
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_repetition(
+		AutomatonBuilder *builder, struct automaton_fragment f){
+	/**
+	 * Makes a fragment matching one or more repetitions of f.  No skip is
+	 * needed, so f's start can stay the start.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = f.start;
+	fragment.end = create_builder_node(builder);
+	add_transition(builder, f.end, 1, 0, 0, f.start);
+	add_transition(builder, f.end, 1, 0, 0, fragment.end);
+	
+	return fragment;
+}
+
+
+struct automaton_fragment automaton_builder_optional(
+		AutomatonBuilder *builder, struct automaton_fragment f){
+	/**
+	 * Makes a fragment matching f or the empty string.
+	 */
+	struct automaton_fragment fragment;
+	fragment.start = create_builder_node(builder);
+	fragment.end = create_builder_node(builder);
+	add_transition(builder, fragment.start, 1, 0, 0, f.start);
+	add_transition(builder, fragment.start, 1, 0, 0, fragment.end);
+	add_transition(builder, f.end, 1, 0, 0, fragment.end);
+	
+	return fragment;
+}
+
+
+FiniteAutomaton *automaton_builder_finish(AutomatonBuilder *builder,
+                                          struct automaton_fragment fragment){
+	/**
+	 * Turns the provided fragment into a nondeterministic automaton, and
+	 * deletes the builder.  The automaton takes over the builder's memory,
+	 * and is then reduced once, so this costs time linear in the size of the
+	 * builder.  Nodes of fragments not used by the provided fragment may be
+	 * kept, but cannot be reached.
+	 */
+	FiniteAutomaton *automaton = malloc(sizeof(FiniteAutomaton));
+	automaton->n_nodes = builder->n_nodes;
+	automaton->starting_state = fragment.start;
+	automaton->arena = builder->arena;
+	automaton->compiled = NULL;
+	automaton->graph = NULL;
+	automaton->simulator = NULL;
+	
+	automaton->nodes = arena_alloc(automaton->arena, builder->n_nodes *
+	                               sizeof(struct automaton_node*));
+	int i;
+	for(i = 0; i < builder->n_nodes; i++){
+		automaton->nodes[i] = builder->nodes[i];
+	}
+	automaton->nodes[fragment.end]->is_ending_state = 1;
+	
+	free(builder->nodes);
+	free(builder);
+	reduce_automaton(automaton);
+	return automaton;
+}
+
+
+void delete_automaton_builder(AutomatonBuilder *builder){
+	/**
+	 * Frees all memory associated with the provided builder, for when it is
+	 * abandoned without being finished.
+	 */
+	if(builder == NULL){
+		return;
+	}
+	delete_arena(builder->arena);
+	free(builder->nodes);
+	free(builder);
+}
@@ -0,0 +1,164 @@
+/**
+ * Contains methods for computing and caching the epsilon closures of the nodes
+ * of a nondeterministic finite automaton.  The public methods are declared in
+ * automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+#include "bitset.h"
+
+
+static void close_component(AutomatonGraph *graph, int *members,
+                            int n_members, int *component, int n_words){
+	/**
+	 * Computes the shared closure of a finished strongly connected component.
+	 * Every component reachable from it has already been finished, so its
+	 * closure is its own members together with the closures of the nodes its
+	 * epsilon transitions leave the component for.
+	 */
+	int c = component[members[0]];
+	uint64_t *closure = graph->closures + members[0] * n_words;
+	
+	int i, e;
+	for(i = 0; i < n_members; i++){
+		bitset_set(closure, members[i]);
+	}
+	for(i = 0; i < n_members; i++){
+		int v = members[i];
+		for(e = graph->epsilon_offsets[v]; e < graph->epsilon_offsets[v + 1]; e++){
+			int w = graph->epsilon_targets[e];
+			if(component[w] != c){
+				bitset_union(closure, graph->closures + w * n_words, n_words);
+			}
+		}
+	}
+	
+	//every member of a component shares the same closure
+	for(i = 1; i < n_members; i++){
+		bitset_copy(graph->closures + members[i] * n_words, closure, n_words);
+	}
+}
+
+
+void compute_graph_closures(AutomatonGraph *graph){
+	/**
+	 * Computes the epsilon closure of every node of the graph, if that has
+	 * not been done already.  The epsilon graph is condensed into strongly
+	 * connected components (Tarjan's algorithm, without recursion) and the
+	 * closures are then propagated between components with bitwise ors, so
+	 * each transition is only followed once.
+	 */
+	if(graph->closures != NULL){
+		return;
+	}
+	int n = graph->n_nodes;
+	int n_words = BITSET_WORDS(n);
+	graph->closures = calloc(n * n_words, sizeof(uint64_t));
+	graph->important = create_bitset(n);
+	
+	//nodes worth keeping in a state: non-epsilon transitions or ending states
+	int i;
+	for(i = 0; i < n; i++){
+		if(graph->ending[i] || graph->offsets[i + 1] > graph->offsets[i]){
+			bitset_set(graph->important, i);
+		}
+	}
+	
+	int *index = malloc(n * sizeof(int)); //discovery order, -1 if unvisited
+	int *low = malloc(n * sizeof(int));
+	int *component = malloc(n * sizeof(int)); //-1 until component finished
+	int *stack = malloc(n * sizeof(int)); //tarjan stack of open nodes
+	int *call_node = malloc(n * sizeof(int)); //explicit recursion stack
+	int *call_edge = malloc(n * sizeof(int)); //next epsilon edge to follow
+	for(i = 0; i < n; i++){
+		index[i] = -1;
+		component[i] = -1;
+	}
+	
+	int counter = 0, n_components = 0, stack_size = 0;
+	int root;
+	for(root = 0; root < n; root++){
+		if(index[root] >= 0){
+			continue;
+		}
+		
+		int depth = 0;
+		call_node[0] = root;
+		call_edge[0] = graph->epsilon_offsets[root];
+		index[root] = low[root] = counter++;
+		stack[stack_size++] = root;
+		
+		while(depth >= 0){
+			int v = call_node[depth];
+			
+			//advance to the next epsilon transition of v
+			if(call_edge[depth] < graph->epsilon_offsets[v + 1]){
+				int w = graph->epsilon_targets[call_edge[depth]++];
+				if(index[w] < 0){
+					//descend
+					index[w] = low[w] = counter++;
+					stack[stack_size++] = w;
+					depth++;
+					call_node[depth] = w;
+					call_edge[depth] = graph->epsilon_offsets[w];
+				}else if(component[w] < 0 && index[w] < low[v]){
+					//w is still open, so it is in the current component
+					low[v] = index[w];
+				}
+				continue;
+			}
+			
+			//all transitions of v are done; close a component if v is a root
+			if(low[v] == index[v]){
+				int start = stack_size;
+				do{
+					start--;
+					component[stack[start]] = n_components;
+				}while(stack[start] != v);
+				close_component(graph, stack + start, stack_size - start,
+				                component, n_words);
+				stack_size = start;
+				n_components++;
+			}
+			
+			//return to the caller
+			depth--;
+			if(depth >= 0){
+				int u = call_node[depth];
+				if(low[v] < low[u]){
+					low[u] = low[v];
+				}
+			}
+		}
+	}
+	
+	free(index);
+	free(low);
+	free(component);
+	free(stack);
+	free(call_node);
+	free(call_edge);
+}
+
+
+void graph_close_state(AutomatonGraph *graph, uint64_t *tentative_state,
+                       uint64_t *new_state){
+	/**
+	 * Fills new_state with the important nodes of the epsilon closure of the
+	 * nodes in tentative_state.  Both are bitsets of node identifiers.
+	 */
+	AUTOMATON_STATS_ADD(closures_computed, 1);
+	compute_graph_closures(graph);
+	int n_words = BITSET_WORDS(graph->n_nodes);
+	
+	bitset_zero(new_state, n_words);
+	int i;
+	for(i = bitset_next(tentative_state, n_words, 0); i >= 0;
+	    i = bitset_next(tentative_state, n_words, i + 1)){
+		bitset_union(new_state, graph->closures + i * n_words, n_words);
+	}
+	bitset_intersect(new_state, graph->important, n_words);
+}
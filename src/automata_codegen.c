@@ -0,0 +1,180 @@
+/**
+ * Contains methods for generating C source code which implements a
+ * deterministic finite automaton directly, with one labelled block per state
+ * and a switch on the next byte, instead of interpreting a table.  The
+ * generated code is standalone: it only needs a C compiler.  The public
+ * methods are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "automata.h"
+
+
+//ranges at most this long become case labels; longer ones become comparisons
+#define CODEGEN_MAX_CASE_RANGE 8
+
+
+static int *reachable_nodes(FiniteAutomaton *dfa){
+	/**
+	 * Returns an array flagging each node which can be reached from the
+	 * starting node, so that no unused labels are generated.
+	 */
+	int *reachable = calloc(dfa->n_nodes, sizeof(int));
+	int *stack = malloc(dfa->n_nodes * sizeof(int));
+	int depth = 0;
+	stack[depth++] = dfa->starting_state;
+	reachable[dfa->starting_state] = 1;
+	
+	int j;
+	while(depth > 0){
+		struct automaton_node *node = dfa->nodes[stack[--depth]];
+		for(j = 0; j < node->n_transitions; j++){
+			int target = node->transitions[j]->identifier;
+			if(!reachable[target]){
+				reachable[target] = 1;
+				stack[depth++] = target;
+			}
+		}
+	}
+	free(stack);
+	return reachable;
+}
+
+
+static void emit_state(FILE *out, struct automaton_node *node, int longest){
+	/**
+	 * Writes the block of code for one state.  Short ranges become case
+	 * labels of a switch (which the compiler can turn into a jump table) and
+	 * long ranges become a single unsigned comparison each.
+	 */
+	int j, c;
+	fprintf(out, "state_%d:\n", node->identifier);
+	if(longest){
+		if(node->is_ending_state){
+			fprintf(out, "\tlast = (int) (p - start);\n");
+		}
+		fprintf(out, "\tif(p == end){\n\t\treturn last;\n\t}\n");
+	}else{
+		fprintf(out, "\tif(p == end){\n\t\treturn %d;\n\t}\n",
+		        node->is_ending_state ? 1 : 0);
+	}
+	if(node->n_transitions == 0){
+		fprintf(out, "\treturn %s;\n\n", longest ? "last" : "0");
+		return;
+	}
+	fprintf(out, "\tc = *p++;\n");
+	
+	//short ranges
+	int n_cases = 0;
+	for(j = 0; j < node->n_transitions; j++){
+		struct automaton_transition *t = node->transitions[j];
+		if(t->high - t->low >= CODEGEN_MAX_CASE_RANGE){
+			continue;
+		}
+		if(n_cases == 0){
+			fprintf(out, "\tswitch(c){\n");
+		}
+		for(c = t->low; c <= t->high; c++){
+			fprintf(out, "\tcase 0x%02x:\n", c);
+		}
+		fprintf(out, "\t\tgoto state_%d;\n", t->identifier);
+		n_cases++;
+	}
+	if(n_cases > 0){
+		fprintf(out, "\tdefault:\n\t\tbreak;\n\t}\n");
+	}
+	
+	//long ranges
+	for(j = 0; j < node->n_transitions; j++){
+		struct automaton_transition *t = node->transitions[j];
+		if(t->high - t->low < CODEGEN_MAX_CASE_RANGE){
+			continue;
+		}
+		if(t->low == 0 && t->high == 255){
+			fprintf(out, "\tgoto state_%d;\n\n", t->identifier);
+			return;
+		}
+		fprintf(out, "\tif((unsigned char) (c - 0x%02x) <= 0x%02x){\n",
+		        t->low, t->high - t->low);
+		fprintf(out, "\t\tgoto state_%d;\n\t}\n", t->identifier);
+	}
+	
+	fprintf(out, "\treturn %s;\n\n", longest ? "last" : "0");
+}
+
+
+static void emit_matcher(FILE *out, FiniteAutomaton *dfa, int *reachable,
+                         const char *name, int longest){
+	/**
+	 * Writes one matching function.  With longest set, it returns the length
+	 * of the longest accepted prefix (or -1); otherwise it returns 1 if the
+	 * whole string is accepted and 0 if not.
+	 */
+	if(longest){
+		fprintf(out, "int %s_longest(const char *string, int length){\n", name);
+	}else{
+		fprintf(out, "int %s(const char *string, int length){\n", name);
+	}
+	fprintf(out, "\tconst unsigned char *start = (const unsigned char*) string;\n");
+	fprintf(out, "\tconst unsigned char *p = start;\n");
+	fprintf(out, "\tconst unsigned char *end = start + length;\n");
+	
+	//states without transitions never read a byte
+	int i, reads = 0;
+	for(i = 0; i < dfa->n_nodes; i++){
+		if(reachable[i] && dfa->nodes[i]->n_transitions > 0){
+			reads = 1;
+		}
+	}
+	if(reads){
+		fprintf(out, "\tunsigned char c;\n");
+	}
+	if(longest){
+		fprintf(out, "\tint last = -1;\n");
+	}else{
+		fprintf(out, "\t(void) start;\n");
+	}
+	fprintf(out, "\tgoto state_%d;\n\n", dfa->starting_state);
+	
+	for(i = 0; i < dfa->n_nodes; i++){
+		if(reachable[i]){
+			emit_state(out, dfa->nodes[i], longest);
+		}
+	}
+	fprintf(out, "}\n\n\n");
+}
+
+
+int generate_automaton_c(FiniteAutomaton *dfa, const char *name, FILE *out){
+	/**
+	 * Writes C source for the provided deterministic automaton to out.  It
+	 * defines two functions:
+	 * 	int name(const char *string, int length)
+	 * returning 1 if the whole string is accepted and 0 if not, and
+	 * 	int name_longest(const char *string, int length)
+	 * returning the length of the longest accepted prefix, or -1 if there is
+	 * none.  Returns 1 for success and 0 if the automaton is not
+	 * deterministic.
+	 */
+	if(dfa == NULL){
+		return 0;
+	}
+	if(!automaton_is_deterministic(dfa)){
+		fprintf(stderr, "Cannot generate code for a non-deterministic ");
+		fprintf(stderr, "automaton.  Please convert to a deterministic ");
+		fprintf(stderr, "automaton.\n");
+		return 0;
+	}
+	
+	int *reachable = reachable_nodes(dfa);
+	fprintf(out, "/*\n * Generated matcher for a deterministic automaton of");
+	fprintf(out, " %d states.  Do not edit.\n */\n\n", dfa->n_nodes);
+	fprintf(out, "int %s(const char *string, int length);\n", name);
+	fprintf(out, "int %s_longest(const char *string, int length);\n\n\n", name);
+	emit_matcher(out, dfa, reachable, name, 0);
+	emit_matcher(out, dfa, reachable, name, 1);
+	
+	free(reachable);
+	return 1;
+}
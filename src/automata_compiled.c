@@ -0,0 +1,345 @@
+/**
+ * Contains methods for compiling deterministic finite automata into dense
+ * transition tables and for running the compiled tables.  The public methods
+ * are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "automata.h"
+
+
+//number of bytes stepped between checks for the dead state
+#define COMPILED_DEAD_CHECK_INTERVAL 64
+
+
+static void fill_targets(struct automaton_node *node, uint32_t *targets){
+	/**
+	 * Fills targets with the compiled state reached from the node on each of
+	 * the 256 bytes (the dead state where there is no transition).
+	 */
+	int j, c;
+	memset(targets, 0, 256 * sizeof(uint32_t));
+	for(j = 0; j < node->n_transitions; j++){
+		struct automaton_transition *t = node->transitions[j];
+		for(c = t->low; c <= t->high; c++){
+			targets[c] = t->identifier + 1;
+		}
+	}
+}
+
+
+static int assign_byte_classes(FiniteAutomaton *automaton,
+                               unsigned char *classes){
+	/**
+	 * Partitions the bytes into equivalence classes: two bytes share a class
+	 * iff every node has the same successor on both.  The partition starts
+	 * with all bytes together and is refined once per node by splitting each
+	 * class according to the node's successors, so the cost is linear in the
+	 * number of nodes.  Returns the number of classes.
+	 */
+	uint32_t targets[256];
+	unsigned char new_classes[256];
+	
+	//small open-addressing map from (old class, successor) to new class,
+	//invalidated between nodes by bumping the stamp
+	uint64_t keys[512];
+	int values[512];
+	int stamps[512];
+	int stamp = 0;
+	memset(stamps, 0, sizeof(stamps));
+	
+	memset(classes, 0, 256);
+	int n_classes = 1;
+	
+	int i, b;
+	for(i = 0; i < automaton->n_nodes && n_classes < 256; i++){
+		fill_targets(automaton->nodes[i], targets);
+		stamp++;
+		
+		int new_n = 0;
+		for(b = 0; b < 256; b++){
+			uint64_t key = ((uint64_t) classes[b] << 32) | targets[b];
+			unsigned long slot = (key * 0x9e3779b97f4a7c15ULL) >> 55;
+			while(stamps[slot] == stamp && keys[slot] != key){
+				slot = (slot + 1) & 511;
+			}
+			if(stamps[slot] != stamp){
+				stamps[slot] = stamp;
+				keys[slot] = key;
+				values[slot] = new_n++;
+			}
+			new_classes[b] = values[slot];
+		}
+		
+		memcpy(classes, new_classes, 256);
+		n_classes = new_n;
+	}
+	return n_classes;
+}
+
+
+static int choose_state_size(int n_states){
+	/**
+	 * Returns the narrowest width of table entry (in bytes) which can hold
+	 * every one of n_states states.
+	 */
+	if(n_states <= 1 << 8){
+		return 1;
+	}
+	if(n_states <= 1 << 16){
+		return 2;
+	}
+	return 4;
+}
+
+
+static void fill_row(CompiledAutomaton *compiled, int state, uint32_t *row){
+	/**
+	 * Stores the next states in row as the table row of the given state, at
+	 * the width of the table's entries.
+	 */
+	int n_classes = compiled->n_classes;
+	unsigned long offset = (unsigned long) state * n_classes;
+	int c;
+	for(c = 0; c < n_classes; c++){
+		switch(compiled->state_size){
+			case 1:
+				((uint8_t*) compiled->table)[offset + c] = row[c];
+				break;
+			case 2:
+				((uint16_t*) compiled->table)[offset + c] = row[c];
+				break;
+			default:
+				((uint32_t*) compiled->table)[offset + c] = row[c];
+				break;
+		}
+	}
+}
+
+
+CompiledAutomaton *compile_automaton(FiniteAutomaton *automaton){
+	/**
+	 * Creates the table-driven form of the provided deterministic automaton.
+	 * Node i of the automaton becomes state i + 1 of the compiled automaton,
+	 * since state zero is reserved for the dead state.  Bytes which behave
+	 * identically share a column, so the table is only as wide as the number
+	 * of byte classes.  Returns NULL if the automaton is not deterministic.
+	 */
+	if(automaton == NULL){
+		return NULL;
+	}
+	if(!automaton_is_deterministic(automaton)){
+		fprintf(stderr, "Cannot compile a non-deterministic automaton.  ");
+		fprintf(stderr, "Please convert to a deterministic automaton.\n");
+		return NULL;
+	}
+	
+	AUTOMATON_SPAN_BEGIN(compile);
+	AUTOMATON_STATS_ADD(tables_compiled, 1);
+	CompiledAutomaton *compiled = malloc(sizeof(CompiledAutomaton));
+	compiled->mapping = NULL;
+	compiled->mapping_size = 0;
+	compiled->n_states = automaton->n_nodes + 1;
+	compiled->starting_state = automaton->starting_state + 1;
+	compiled->n_classes = assign_byte_classes(automaton, compiled->classes);
+	
+	//one representative byte per class
+	int n_classes = compiled->n_classes;
+	unsigned char representatives[256];
+	int b;
+	for(b = 255; b >= 0; b--){
+		representatives[compiled->classes[b]] = b;
+	}
+	
+	//every entry of the dead state's row leads back to it
+	compiled->state_size = choose_state_size(compiled->n_states);
+	compiled->table = calloc((unsigned long) compiled->n_states * n_classes,
+	                         compiled->state_size);
+	compiled->accepting = calloc(compiled->n_states, sizeof(unsigned char));
+	compiled->tokens = malloc(compiled->n_states * sizeof(int));
+	compiled->tokens[COMPILED_DEAD_STATE] = -1;
+	
+	uint32_t targets[256];
+	uint32_t row[256];
+	int i, c;
+	for(i = 0; i < automaton->n_nodes; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		
+		compiled->accepting[i + 1] = node->is_ending_state ? 1 : 0;
+		compiled->tokens[i + 1] = node->is_ending_state ? node->token : -1;
+		fill_targets(node, targets);
+		for(c = 0; c < n_classes; c++){
+			row[c] = targets[representatives[c]];
+		}
+		fill_row(compiled, i + 1, row);
+	}
+	
+	AUTOMATON_SPAN_END(compile);
+	return compiled;
+}
+
+
+/*
+ * The matcher loops are written once as macros and expanded for each width of
+ * table entry, so the inner loop of each reads its table directly.
+ */
+#define DEFINE_RUN(type) \
+static uint32_t run_##type(CompiledAutomaton *compiled, uint32_t s, \
+                           unsigned char *bytes, int length){ \
+	type *table = compiled->table; \
+	unsigned char *classes = compiled->classes; \
+	int n_classes = compiled->n_classes; \
+	int i = 0; \
+	while(i < length){ \
+		int stop = i + COMPILED_DEAD_CHECK_INTERVAL; \
+		if(stop > length){ \
+			stop = length; \
+		} \
+		for(; i < stop; i++){ \
+			s = table[s * n_classes + classes[bytes[i]]]; \
+		} \
+		if(s == COMPILED_DEAD_STATE){ \
+			break; \
+		} \
+	} \
+	AUTOMATON_STATS_ADD(bytes_matched, i); \
+	return s; \
+}
+
+#define DEFINE_RUN_LONGEST(type) \
+static uint32_t run_longest_##type(CompiledAutomaton *compiled, uint32_t s, \
+                                   unsigned char *bytes, int length, \
+                                   int *last_accept, int *accept_state){ \
+	type *table = compiled->table; \
+	unsigned char *classes = compiled->classes; \
+	unsigned char *accepting = compiled->accepting; \
+	int n_classes = compiled->n_classes; \
+	int i; \
+	for(i = 0; i < length; i++){ \
+		s = table[s * n_classes + classes[bytes[i]]]; \
+		if(accepting[s]){ \
+			*last_accept = i + 1; \
+			*accept_state = s; \
+		}else if(s == COMPILED_DEAD_STATE){ \
+			break; \
+		} \
+	} \
+	AUTOMATON_STATS_ADD(bytes_matched, i); \
+	return s; \
+}
+
+DEFINE_RUN(uint8_t)
+DEFINE_RUN(uint16_t)
+DEFINE_RUN(uint32_t)
+DEFINE_RUN_LONGEST(uint8_t)
+DEFINE_RUN_LONGEST(uint16_t)
+DEFINE_RUN_LONGEST(uint32_t)
+
+
+int compiled_automaton_run(CompiledAutomaton *compiled, int state,
+                           char *string, int length){
+	/**
+	 * Steps the compiled automaton through the provided string starting from
+	 * the given state and returns the state reached.  Stops early once the
+	 * dead state is reached, since it can never be left.
+	 */
+	unsigned char *bytes = (unsigned char*) string;
+	switch(compiled->state_size){
+		case 1:
+			return run_uint8_t(compiled, state, bytes, length);
+		case 2:
+			return run_uint16_t(compiled, state, bytes, length);
+		default:
+			return run_uint32_t(compiled, state, bytes, length);
+	}
+}
+
+
+int compiled_automaton_run_longest(CompiledAutomaton *compiled, int state,
+                                   char *string, int length, int *last_accept,
+                                   int *accept_state){
+	/**
+	 * Like compiled_automaton_run, but also records in last_accept the number
+	 * of bytes consumed the last time the automaton was in an accepting state
+	 * (not counting the starting state), and that state in accept_state.
+	 * Both are left alone if no accepting state is reached.
+	 */
+	unsigned char *bytes = (unsigned char*) string;
+	switch(compiled->state_size){
+		case 1:
+			return run_longest_uint8_t(compiled, state, bytes, length,
+			                           last_accept, accept_state);
+		case 2:
+			return run_longest_uint16_t(compiled, state, bytes, length,
+			                            last_accept, accept_state);
+		default:
+			return run_longest_uint32_t(compiled, state, bytes, length,
+			                            last_accept, accept_state);
+	}
+}
+
+
+int compiled_automaton_test_string(CompiledAutomaton *compiled, char *string,
+                                   int length){
+	/**
+	 * Tests the provided string of the specified length against the compiled
+	 * automaton.  Returns 0 for failure and 1 for success.
+	 */
+	int state = compiled_automaton_run(compiled, compiled->starting_state,
+	                                   string, length);
+	return compiled->accepting[state];
+}
+
+
+uint32_t compiled_automaton_entry(CompiledAutomaton *compiled,
+                                  unsigned long index){
+	/**
+	 * Returns entry index of the compiled automaton's table (the next state
+	 * from state index / n_classes on class index % n_classes), whatever the
+	 * width of its entries.  Meant for code off the matching path.
+	 */
+	switch(compiled->state_size){
+		case 1:
+			return ((uint8_t*) compiled->table)[index];
+		case 2:
+			return ((uint16_t*) compiled->table)[index];
+		default:
+			return ((uint32_t*) compiled->table)[index];
+	}
+}
+
+
+CompiledAutomaton *get_compiled_automaton(FiniteAutomaton *automaton){
+	/**
+	 * Returns the compiled table of the provided deterministic automaton,
+	 * compiling it first if that has not been done yet.  Returns NULL if the
+	 * automaton is not deterministic.
+	 */
+	if(automaton->compiled == NULL){
+		automaton->compiled = compile_automaton(automaton);
+	}
+	return automaton->compiled;
+}
+
+
+void delete_compiled_automaton(CompiledAutomaton *compiled){
+	/**
+	 * Frees all memory associated with the specified compiled automaton
+	 */
+	if(compiled == NULL){
+		return;
+	}
+	if(compiled->mapping != NULL){
+		//the tables belong to the mapped file (see automata_binary.c)
+		munmap(compiled->mapping, compiled->mapping_size);
+		free(compiled);
+		return;
+	}
+	free(compiled->table);
+	free(compiled->accepting);
+	free(compiled->tokens);
+	free(compiled);
+}
@@ -4,459 +4,786 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "automata.h"
-#include "byte_data.h"
-#include "linked_list.h"
+#include "bitset.h"
+#include "hash_table.h"
 
 
-static void fill(struct automaton_node *node, void *new_state, void *touched, 
-                    FiniteAutomaton *automaton, LinkedList *transition_chars){
+struct alphabet {
 	/**
-	 * Helper function for recursively converting to a deterministic automaton.
+	 * The bytes used by an automaton's transitions, split into symbols: the
+	 * largest ranges of bytes which every transition either wholly matches or
+	 * wholly does not.  Symbols are numbered in byte order, so each
+	 * transition matches a consecutive run of them.
 	 */
-	int identifier = node->identifier;
-	
-	//if already touched, do nothing
-	if(read_bit_byte_data(touched, identifier)){
-		return;
-	}
-	
-	//touch the current node
-	write_bit_byte_data(touched, identifier, 1);
+	int n_symbols;
+	int symbol[256]; //symbol of each byte, -1 if no transition matches it
+	unsigned char low[256]; //first byte of each symbol
+	unsigned char high[256]; //last byte of each symbol
+};
+
+
+static void partition_alphabet(AutomatonGraph *graph,
+                               struct alphabet *alphabet){
+	/**
+	 * Splits the bytes matched by the graph's transitions into symbols.  A
+	 * symbol boundary falls wherever some transition's range starts or ends,
+	 * so a sweep over the bytes finds them all.
+	 */
+	int boundary[257]; //one where a range starts or follows a range's end
+	int coverage[257]; //change in the number of ranges matching the byte
+	memset(boundary, 0, sizeof(boundary));
+	memset(coverage, 0, sizeof(coverage));
 	
-	//process all epsilon and non-epsilon transitions
-	int has_non_epsilon = 0;
 	int i;
-	for(i = 0; i < node->n_transitions; i++){
-		struct automaton_transition *transition = node->transitions[i];
-		if(transition->is_epsilon){
-			struct automaton_node *next_node;
-			next_node = automaton->nodes[transition->identifier];
-			fill(next_node, new_state, touched, automaton, transition_chars);
-		}else{
-			has_non_epsilon = 1;
-			//make sure the list of valid transition chars has this one
-			char *c = malloc(sizeof(char));
-			*c = transition->condition;
-			if(!linked_list_contains(transition_chars, c)){
-				append_linked_list(transition_chars, c);
-			}else{
-				free(c);
-			}
-		}
+	for(i = 0; i < graph->n_transitions; i++){
+		boundary[graph->low[i]] = 1;
+		boundary[graph->high[i] + 1] = 1;
+		coverage[graph->low[i]]++;
+		coverage[graph->high[i] + 1]--;
 	}
 	
-	//include in the new state if it has a non-epsilon transition or if finish
-	if(has_non_epsilon||node->is_ending_state){
-		write_bit_byte_data(new_state, identifier, 1);
+	int c, covered = 0;
+	alphabet->n_symbols = 0;
+	for(c = 0; c < 256; c++){
+		covered += coverage[c];
+		if(covered == 0){
+			alphabet->symbol[c] = -1;
+			continue;
+		}
+		if(boundary[c] || alphabet->symbol[c - 1] < 0){
+			alphabet->low[alphabet->n_symbols] = c;
+			alphabet->n_symbols++;
+		}
+		alphabet->symbol[c] = alphabet->n_symbols - 1;
+		alphabet->high[alphabet->n_symbols - 1] = c;
 	}
 }
 
 
 
-static void process(void *tentative_state, void *previous_node, char tchar,
-                    LinkedList *node_list, FiniteAutomaton *automaton,
-                    LinkedList *transition_chars, 
-                    LinkedList *trans_from, LinkedList *trans_to,
-                    LinkedList *trans_con, LinkedList *finish){
-	/*
-	 * Good Luck.
+static FiniteAutomaton *build_from_table(int n, struct alphabet *alphabet,
+                                        int *table, int *accept,
+                                        int starting_state){
+	/**
+	 * Makes a deterministic automaton with n nodes from a dense transition
+	 * table: entry i * n_symbols + s is the node reached from node i on
+	 * symbol s of the alphabet (or -1 for no transition).  accept holds the
+	 * token of each ending node and -1 for the other nodes.  Symbols next to
+	 * each other in byte order which lead to the same node share a single
+	 * range transition.
 	 */
-	unsigned long data_size = 1 + (automaton->n_nodes / 8);
-	
-	//first, fill out the tentative state
-	void *new_state, *touched;
-	new_state = calloc(data_size, 1);
-	touched = calloc(data_size, 1);
-	
-	int i, j, k;
-	for(i = 0; i < automaton->n_nodes; i++){
-		if(read_bit_byte_data(tentative_state, i)){
-			struct automaton_node *node = automaton->nodes[i];
-			fill(node, new_state, touched, automaton, transition_chars);
-		}
-	}
-	free(touched);
-	
-	if(byte_data_is_zero(new_state, data_size)){
-		return;
-	}
-	
-	//Add connection from previous node state to new state
-	if(previous_node != NULL){
-		append_linked_list(trans_from, previous_node);
-		append_linked_list(trans_to, new_state);
-		char *c = malloc(sizeof(char));
-		*c = tchar;
-		append_linked_list(trans_con, c);
-	}
-	
-	
-	
-	//check to see if there is already a node for this state, or if it is zero
-	if(linked_list_contains(node_list, new_state)){
-		return;
-	}
-	
-	
-	//make new node
-	append_linked_list(node_list, new_state);
-	
-	//check to see if this is a finished state
-	char *fstate = malloc(sizeof(char));
-	*fstate = 0;
-	for(i = 0; i < automaton->n_nodes; i++){
-		if(read_bit_byte_data(new_state, i)){
-			struct automaton_node *node = automaton->nodes[i];
-			if(node->is_ending_state){
-				*fstate = 1;
-				break;
+	FiniteAutomaton *automaton = create_automaton_empty(n);
+	automaton->starting_state = starting_state;
+	int n_symbols = alphabet->n_symbols;
+	
+	//fill in nodes
+	int id, i;
+	for(id = 0; id < n; id++){
+		int *row = table + id * n_symbols;
+		struct automaton_node *node = automaton->nodes[id];
+		node->is_ending_state = accept[id] >= 0;
+		node->token = accept[id] >= 0 ? accept[id] : 0;
+		
+		//count transitions, merging adjacent symbols
+		int nt = 0;
+		for(i = 0; i < n_symbols; i++){
+			int merged = i > 0 && row[i] == row[i - 1] &&
+			             alphabet->low[i] == alphabet->high[i - 1] + 1;
+			if(row[i] >= 0 && !merged){
+				nt++;
 			}
 		}
-	}
-	append_linked_list(finish, fstate);
-	
-	
-	
-	//look for outgoing transitions
-	int n_chars = count_linked_list(transition_chars);
-	for(i = 0; i < n_chars; i++){
-		char c = *((char*) get_linked_list(transition_chars, i));
 		
-		void *new_tentative_state = calloc(data_size, 1);
+		//make transitions
+		struct automaton_transition *transitions;
+		transitions = allocate_transitions(automaton, node, nt);
 		
-		for(j = 0; j < automaton->n_nodes; j++){
-			if(read_bit_byte_data(new_state, j)){
-				struct automaton_node *node = automaton->nodes[j];
-				for(k = 0; k < node->n_transitions; k++){
-					struct automaton_transition *t = node->transitions[k];
-					if(t->condition == c){
-						/*
-						 * We have found a transition of this character type, so
-						 * add its destination to the new tentative state
-						 */
-						write_bit_byte_data(new_tentative_state, t->identifier, 1);
-					}
-				}
+		int tcount = 0;
+		for(i = 0; i < n_symbols; i++){
+			if(row[i] < 0){
+				continue;
 			}
+			if(i > 0 && row[i] == row[i - 1] &&
+			   alphabet->low[i] == alphabet->high[i - 1] + 1){
+				transitions[tcount - 1].high = alphabet->high[i];
+				continue;
+			}
+			transitions[tcount].is_epsilon = 0;
+			transitions[tcount].low = alphabet->low[i];
+			transitions[tcount].high = alphabet->high[i];
+			transitions[tcount].identifier = row[i];
+			tcount++;
 		}
-		
-		
-		process(new_tentative_state, new_state, c, node_list, automaton, 
-		        transition_chars, trans_from, trans_to, trans_con, finish);
-		free(new_tentative_state);
 	}
 	
+	return automaton;
 }
 
 
 
-FiniteAutomaton *create_automaton_deterministic(FiniteAutomaton *ndfa){
+static FiniteAutomaton *determinize(FiniteAutomaton *ndfa, int flags,
+                                   HashTable *token_sets){
 	/**
 	 * Creates a deterministic finite automaton equivalent to the provided
-	 * non-deterministic finite automaton.
+	 * non-deterministic finite automaton.  If flags includes
+	 * AUTOMATON_MINIMIZE, the result is also minimized.  A deterministic
+	 * node containing several ending nodes takes the lowest of their tokens,
+	 * unless token_sets is given: then it takes the identifier of the set of
+	 * all of their tokens, interned in token_sets.
 	 */
 	if(ndfa == NULL){
 		return NULL;
 	}
 	
 	/*
-	 * First, we must collect all data needed to make the new automaton.
-	 * We need:
-	 * 	1) A list of states for the new nodes.
-	 * 	2) A list of transitions.
+	 * The table of states doubles as the worklist: states are given
+	 * identifiers in order of discovery, so every identifier below the
+	 * table's count which has not yet been visited is still pending.  Each
+	 * visited state writes its row of the dense transition table directly.
+	 * All edge walks go through the flat graph layout.  The table has one
+	 * column per symbol of the alphabet rather than per byte, so a range
+	 * transition costs the same as a single character unless other
+	 * transitions split its range.
 	 */
+	AUTOMATON_SPAN_BEGIN(determinize);
+	AutomatonGraph *graph = get_automaton_graph(ndfa);
+	int n_words = BITSET_WORDS(graph->n_nodes);
+	
+	struct alphabet alphabet;
+	partition_alphabet(graph, &alphabet);
+	int n_symbols = alphabet.n_symbols;
+	
+	HashTable *states = create_hash_table(n_words * sizeof(uint64_t));
+	int capacity = 16;
+	int *table = malloc(capacity * n_symbols * sizeof(int));
+	int *accept = malloc(capacity * sizeof(int));
+	
+	//scratch space: the current state, one tentative state per symbol,
+	//and the closure of a tentative state
+	uint64_t *current = create_bitset(graph->n_nodes);
+	uint64_t *moves = malloc(n_symbols * n_words * sizeof(uint64_t));
+	uint64_t *new_state = create_bitset(graph->n_nodes);
+	
+	//tokens of the ending nodes of a state, when collecting token sets
+	int token_words = 0;
+	uint64_t *tokens = NULL;
+	if(token_sets != NULL){
+		token_words = token_sets->data_size / sizeof(uint64_t);
+		tokens = create_bitset(token_words * 64);
+	}
 	
-	//determine state data size is bytes
-	unsigned long data_size = 1 + (ndfa->n_nodes / 8);
-	
-	//List objects
-	LinkedList *states = create_linked_list(data_size);
-	LinkedList *finish = create_linked_list(sizeof(char));
-	LinkedList *trans_from = create_linked_list(data_size);
-	LinkedList *trans_to = create_linked_list(data_size);
-	LinkedList *trans_con = create_linked_list(sizeof(char));
-	LinkedList *tchars = create_linked_list(sizeof(char));
-	
-	
-	//make tentative starting state
-	void *starting = calloc(data_size, 1);
-	write_bit_byte_data(starting, ndfa->starting_state, 1);
-	
-	//recursively collect data about new nodes
-	process(starting, NULL, ' ', states, ndfa, tchars, trans_from, trans_to, 
-	        trans_con, finish);
+	//make starting state
+	uint64_t *starting = create_bitset(graph->n_nodes);
+	bitset_set(starting, graph->starting_state);
+	graph_close_state(graph, starting, new_state);
+	hash_table_intern(states, new_state, NULL);
 	free(starting);
 	
-	/*print_linked_list(states);
-	print_linked_list(finish);
-	print_linked_list(tchars);
-	print_linked_list(trans_from);
-	print_linked_list(trans_to);
-	print_linked_list(trans_con);*/
-	
-	/*
-	 * Now that we have all of the information we need, make the new automaton
-	 * object.
-	 */
-	FiniteAutomaton *automaton = malloc(sizeof(FiniteAutomaton));
-	
-	
-	automaton->lookup_table = NULL;
-	automaton->transition_chars = NULL;
-	automaton->n_transition_chars = 0;
-	
-	int n = count_linked_list(states);
-	automaton->n_nodes = n;
-	automaton->starting_state = 0;
-	automaton->nodes = malloc(n * sizeof(struct automaton_node*));
-	
-	//make nodes
-	int i, j;
-	for(i = 0; i < n; i++){
-		void *state = get_linked_list(states, i);
-		struct automaton_node *node = malloc(sizeof(struct automaton_node));
-		node->identifier = i;
-		node->is_ending_state = *((char *)get_linked_list(finish, i));
+	int id, i, j, k;
+	for(id = 0; id < count_hash_table(states); id++){
+		//keys move when the table grows, so work from a copy
+		bitset_copy(current, get_hash_table(states, id), n_words);
 		
-		//count transitions
-		int nt = 0;
-		for(j = 0; j < count_linked_list(trans_from); j++){
-			void *from = get_linked_list(trans_from, j);
-			if(compare_byte_data(from, state, data_size)){
-				nt++;
+		if(id == capacity){
+			capacity *= 2;
+			table = realloc(table, capacity * n_symbols * sizeof(int));
+			accept = realloc(accept, capacity * sizeof(int));
+		}
+		
+		//collect destinations of every transition out of this state at once
+		accept[id] = -1;
+		bitset_zero(moves, n_symbols * n_words);
+		if(tokens != NULL){
+			bitset_zero(tokens, token_words);
+		}
+		for(i = bitset_next(current, n_words, 0); i >= 0;
+		    i = bitset_next(current, n_words, i + 1)){
+			if(graph->ending[i] && tokens != NULL){
+				bitset_set(tokens, graph->tokens[i]);
+				accept[id] = 0;
+			}else if(graph->ending[i]){
+				if(accept[id] < 0 || graph->tokens[i] < accept[id]){
+					accept[id] = graph->tokens[i];
+				}
+			}
+			for(j = graph->offsets[i]; j < graph->offsets[i + 1]; j++){
+				int first = alphabet.symbol[graph->low[j]];
+				int last = alphabet.symbol[graph->high[j]];
+				for(k = first; k <= last; k++){
+					bitset_set(moves + k * n_words, graph->targets[j]);
+				}
 			}
 		}
 		
-		//make transitions
-		node->n_transitions = nt;
-		node->transitions = malloc(nt * sizeof(struct automaton_transition*));
+		if(tokens != NULL && accept[id] >= 0){
+			accept[id] = hash_table_intern(token_sets, tokens, NULL);
+		}
 		
-		int tcount = 0;
-		for(j = 0; j < count_linked_list(trans_from); j++){
-			void *from = get_linked_list(trans_from, j);
-			if(compare_byte_data(from, state, data_size)){
-				void *to = get_linked_list(trans_to, j);
-				struct automaton_transition *transition;
-				transition = malloc(sizeof(struct automaton_transition));
-				transition->is_epsilon = 0;
-				
-				char c = *((char*) get_linked_list(trans_con, j));
-				transition->condition = c;
-				
-				int staten = linked_list_find(states, to);
-				transition->identifier = staten;
-				
-				node->transitions[tcount] = transition;
-				tcount++;
+		//close each tentative state and write the row
+		int *row = table + id * n_symbols;
+		for(i = 0; i < n_symbols; i++){
+			graph_close_state(graph, moves + i * n_words, new_state);
+			if(!bitset_is_empty(new_state, n_words)){
+				row[i] = hash_table_intern(states, new_state, NULL);
+			}else{
+				row[i] = -1;
 			}
 		}
-		
-		automaton->nodes[i] = node;
 	}
+	free(current);
+	free(moves);
+	free(new_state);
+	free(tokens);
 	
+	/*
+	 * Now that we have all of the information we need, make the new automaton
+	 * object.
+	 */
+	FiniteAutomaton *automaton;
+	automaton = build_from_table(count_hash_table(states), &alphabet, table,
+	                             accept, 0);
+	AUTOMATON_STATS_ADD(dfa_states, count_hash_table(states));
 	
 	//clean up and exit
-	delete_linked_list_deep(states);
-	delete_linked_list_deep(finish);
-	delete_linked_list_deep(tchars);
-	delete_linked_list(trans_from);
-	delete_linked_list(trans_to);
-	delete_linked_list_deep(trans_con);
+	delete_hash_table(states);
+	free(table);
+	free(accept);
+	AUTOMATON_SPAN_END(determinize);
+	
+	if(flags & AUTOMATON_MINIMIZE){
+		FiniteAutomaton *minimal = minimize_automaton(automaton);
+		delete_automaton(automaton);
+		automaton = minimal;
+	}
 	return automaton;
 }
 
 
+FiniteAutomaton *create_automaton_deterministic_flags(FiniteAutomaton *ndfa,
+                                                      int flags){
+	/**
+	 * Creates a deterministic finite automaton equivalent to the provided
+	 * non-deterministic finite automaton.  If flags includes
+	 * AUTOMATON_MINIMIZE, the result is also minimized.  A deterministic
+	 * node containing several ending nodes takes the lowest of their tokens.
+	 */
+	return determinize(ndfa, flags, NULL);
+}
+
 
-int automaton_is_deterministic(FiniteAutomaton *automaton){
+FiniteAutomaton *create_automaton_deterministic_sets(FiniteAutomaton *ndfa,
+                                                     int flags,
+                                                     HashTable *token_sets){
 	/**
-	 * Determines if the provided automaton is deterministic by checking to see
-	 * if any of the transitions are epsilon transitions.
+	 * Like create_automaton_deterministic_flags, but an ending node of the
+	 * result takes the identifier of the set of tokens of every ending node
+	 * it contains, as a bitset interned in token_sets.  The keys of
+	 * token_sets must be whole words, with a bit for every token.  Since
+	 * minimization only merges ending nodes with the same token, it keeps
+	 * nodes with different sets apart.
 	 */
-	int i, j;
-	for(i = 0; i < automaton->n_nodes; i++){
-		struct automaton_node *node = automaton->nodes[i];
-		for(j = 0; j < node->n_transitions; j++){
-			struct automaton_transition *transition = node->transitions[j];
-			if(transition->is_epsilon){
-				return 0;
-			}
+	return determinize(ndfa, flags, token_sets);
+}
+
+
+FiniteAutomaton *create_automaton_deterministic(FiniteAutomaton *ndfa){
+	/**
+	 * Creates a deterministic finite automaton equivalent to the provided
+	 * non-deterministic finite automaton.
+	 */
+	return create_automaton_deterministic_flags(ndfa, 0);
+}
+
+
+
+/*
+ * Minimization
+ */
+struct partition {
+	/**
+	 * A partition of states into blocks for Hopcroft's algorithm.  The states
+	 * of each block are contiguous in elements, and the marked states of a
+	 * block are kept at the start of its range.
+	 */
+	int *elements; //states, grouped by block
+	int *position; //index of each state in elements
+	int *block; //block containing each state
+	int *first; //start of each block's range in elements
+	int *end; //end (exclusive) of each block's range in elements
+	int *marked; //number of marked states in each block
+	int n_blocks;
+};
+
+
+static void init_partition(struct partition *p, int n, int *labels){
+	/**
+	 * Makes the initial partition of n states, with one block per distinct
+	 * label.  Labels must be non-negative.
+	 */
+	p->elements = malloc(n * sizeof(int));
+	p->position = malloc(n * sizeof(int));
+	p->block = malloc(n * sizeof(int));
+	p->first = malloc(n * sizeof(int));
+	p->end = malloc(n * sizeof(int));
+	p->marked = calloc(n, sizeof(int));
+	
+	//counting sort of the states by label
+	int i, max_label = 0;
+	for(i = 0; i < n; i++){
+		if(labels[i] > max_label){
+			max_label = labels[i];
 		}
 	}
+	int *counts = calloc(max_label + 2, sizeof(int));
+	for(i = 0; i < n; i++){
+		counts[labels[i] + 1]++;
+	}
+	for(i = 0; i < max_label; i++){
+		counts[i + 1] += counts[i];
+	}
+	for(i = 0; i < n; i++){
+		p->elements[counts[labels[i]]++] = i;
+	}
+	free(counts);
 	
-	return 1;
+	p->n_blocks = 0;
+	for(i = 0; i < n; i++){
+		int q = p->elements[i];
+		if(i == 0 || labels[q] != labels[p->elements[i - 1]]){
+			if(p->n_blocks > 0){
+				p->end[p->n_blocks - 1] = i;
+			}
+			p->first[p->n_blocks] = i;
+			p->n_blocks++;
+		}
+		p->position[q] = i;
+		p->block[q] = p->n_blocks - 1;
+	}
+	p->end[p->n_blocks - 1] = n;
 }
 
 
-/*
- * Lookup Table/execution methods
- */
+static void delete_partition(struct partition *p){
+	/**
+	 * Frees the arrays of the partition.
+	 */
+	free(p->elements);
+	free(p->position);
+	free(p->block);
+	free(p->first);
+	free(p->end);
+	free(p->marked);
+}
 
 
-static void generate_lookup_table(FiniteAutomaton *automaton){
+static void mark_state(struct partition *p, int q, int *touched,
+                       int *n_touched){
 	/**
-	 * Creates or updates the lookup table for the specified automaton.
+	 * Marks state q by swapping it into the marked prefix of its block.  The
+	 * block is recorded as touched the first time one of its states is marked.
 	 */
-	if(!automaton_is_deterministic(automaton)){
-		printf("Cannot generate a lookup table for a non-deterministic ");
-		printf("automaton.  Please convert to a deterministic automaton.");
+	int x = p->block[q];
+	int target = p->first[x] + p->marked[x];
+	if(p->position[q] < target){
+		//already marked
 		return;
 	}
+	if(p->marked[x] == 0){
+		touched[(*n_touched)++] = x;
+	}
 	
-	printf("Generating lookup data for automata of size %d.\n", automaton->n_nodes);
+	int other = p->elements[target];
+	p->elements[p->position[q]] = other;
+	p->position[other] = p->position[q];
+	p->elements[target] = q;
+	p->position[q] = target;
+	p->marked[x]++;
+}
+
+
+static int minimal_partition(struct partition *p, int n, int k, int *delta,
+                             int *labels){
+	/**
+	 * Refines the partition of the n states of a complete automaton (whose
+	 * next state from q on character a is delta[q * k + a]) until it is the
+	 * coarsest one compatible with the transitions, using Hopcroft's algorithm
+	 * in O(n k log n).  Returns the number of blocks.
+	 */
+	int q, a, i, j;
+	init_partition(p, n, labels);
+	
+	//inverse transitions: sources of a into t are inv_sources[inv_first[a*n+t]..]
+	int *inv_first = calloc(k * n + 1, sizeof(int));
+	int *inv_sources = malloc((n * k + 1) * sizeof(int));
+	for(q = 0; q < n; q++){
+		for(a = 0; a < k; a++){
+			inv_first[a * n + delta[q * k + a] + 1]++;
+		}
+	}
+	for(i = 0; i < k * n; i++){
+		inv_first[i + 1] += inv_first[i];
+	}
+	int *fill = malloc((k * n + 1) * sizeof(int));
+	memcpy(fill, inv_first, (k * n + 1) * sizeof(int));
+	for(q = 0; q < n; q++){
+		for(a = 0; a < k; a++){
+			inv_sources[fill[a * n + delta[q * k + a]]++] = q;
+		}
+	}
+	free(fill);
+	
+	//worklist of (block, character) splitters, each present at most once
+	int *worklist = malloc((n * k + 1) * sizeof(int));
+	char *in_worklist = calloc(n * k + 1, sizeof(char));
+	int n_worklist = 0;
+	
+	//start with every initial block but the largest
+	int largest = 0;
+	for(i = 1; i < p->n_blocks; i++){
+		if(p->end[i] - p->first[i] > p->end[largest] - p->first[largest]){
+			largest = i;
+		}
+	}
+	for(i = 0; i < p->n_blocks; i++){
+		if(i == largest){
+			continue;
+		}
+		for(a = 0; a < k; a++){
+			worklist[n_worklist++] = i * k + a;
+			in_worklist[i * k + a] = 1;
+		}
+	}
 	
-	//Just to make sure there is no residual data
-	free(automaton->lookup_table);
-	free(automaton->transition_chars);
+	int *splitter = malloc(n * sizeof(int));
+	int *touched = malloc(n * sizeof(int));
+	while(n_worklist > 0){
+		int entry = worklist[--n_worklist];
+		in_worklist[entry] = 0;
+		int b = entry / k;
+		a = entry % k;
+		
+		//marking reorders blocks, so work from a copy of the splitter
+		int size = p->end[b] - p->first[b];
+		memcpy(splitter, p->elements + p->first[b], size * sizeof(int));
+		
+		int n_touched = 0;
+		for(i = 0; i < size; i++){
+			int t = splitter[i];
+			for(j = inv_first[a * n + t]; j < inv_first[a * n + t + 1]; j++){
+				mark_state(p, inv_sources[j], touched, &n_touched);
+			}
+		}
+		
+		//split every touched block into its marked and unmarked states
+		for(i = 0; i < n_touched; i++){
+			int x = touched[i];
+			int m = p->marked[x];
+			int total = p->end[x] - p->first[x];
+			p->marked[x] = 0;
+			if(m == total){
+				continue;
+			}
+			
+			int y = p->n_blocks++;
+			p->first[y] = p->first[x];
+			p->end[y] = p->first[x] + m;
+			p->first[x] += m;
+			for(j = p->first[y]; j < p->end[y]; j++){
+				p->block[p->elements[j]] = y;
+			}
+			
+			int c;
+			for(c = 0; c < k; c++){
+				int add;
+				if(in_worklist[x * k + c]){
+					add = y;
+				}else{
+					add = (m <= total - m) ? y : x;
+				}
+				worklist[n_worklist++] = add * k + c;
+				in_worklist[add * k + c] = 1;
+			}
+		}
+	}
 	
-	/*
-	 * Index all characters used
+	free(splitter);
+	free(touched);
+	free(worklist);
+	free(in_worklist);
+	free(inv_first);
+	free(inv_sources);
+	return p->n_blocks;
+}
+
+
+FiniteAutomaton *minimize_automaton(FiniteAutomaton *dfa){
+	/**
+	 * Creates the minimal deterministic finite automaton equivalent to the
+	 * provided deterministic automaton.  Unreachable nodes are dropped, and so
+	 * are nodes from which no ending state can be reached.  Ending nodes are
+	 * only merged if they have the same token.  Returns NULL if the automaton
+	 * is not deterministic.
 	 */
+	if(dfa == NULL){
+		return NULL;
+	}
+	if(!automaton_is_deterministic(dfa)){
+		fprintf(stderr, "Cannot minimize a non-deterministic automaton.  ");
+		fprintf(stderr, "Please convert to a deterministic automaton.\n");
+		return NULL;
+	}
 	
-	//make a temporary list of transition characters
-	LinkedList *char_list = create_linked_list(sizeof(char));
-	automaton->n_transition_chars = 0;
-	int i, j, k;
-	for(i = 0; i < automaton->n_nodes; i++){
-		struct automaton_node *node = automaton->nodes[i];
-		for(j = 0; j < node->n_transitions; j++){
-			struct automaton_transition *t = node->transitions[j];
-			char *c = malloc(sizeof(char));
-			*c = t->condition;
-			if(!linked_list_contains(char_list, c)){
-				append_linked_list(char_list, c);
-				automaton->n_transition_chars++;
-			}else{
-				free(c);
+	AUTOMATON_SPAN_BEGIN(minimize);
+	AutomatonGraph *graph = get_automaton_graph(dfa);
+	struct alphabet alphabet;
+	partition_alphabet(graph, &alphabet);
+	int k = alphabet.n_symbols;
+	
+	//number the reachable nodes in breadth first order
+	int *order = malloc(graph->n_nodes * sizeof(int));
+	int *number = malloc(graph->n_nodes * sizeof(int));
+	int q, a, i;
+	for(i = 0; i < graph->n_nodes; i++){
+		number[i] = -1;
+	}
+	int r = 1;
+	order[0] = graph->starting_state;
+	number[graph->starting_state] = 0;
+	for(q = 0; q < r; q++){
+		int v = order[q];
+		for(i = graph->offsets[v]; i < graph->offsets[v + 1]; i++){
+			int t = graph->targets[i];
+			if(number[t] < 0){
+				number[t] = r;
+				order[r++] = t;
 			}
 		}
 	}
 	
-	//make char index
-	int ntc = automaton->n_transition_chars;
-	automaton->transition_chars = malloc(ntc * sizeof(char));
-	for(i = 0; i < ntc; i++){
-		char *c = get_linked_list(char_list, i);
-		automaton->transition_chars[i] = *c;
+	//complete the automaton with an extra dead state, r
+	int n = r + 1;
+	int dead = r;
+	int *delta = malloc(n * k * sizeof(int));
+	int *labels = malloc(n * sizeof(int));
+	for(i = 0; i < n * k; i++){
+		delta[i] = dead;
+	}
+	labels[dead] = 0;
+	for(q = 0; q < r; q++){
+		int v = order[q];
+		labels[q] = graph->ending[v] ? graph->tokens[v] + 1 : 0;
+		for(i = graph->offsets[v]; i < graph->offsets[v + 1]; i++){
+			int last = alphabet.symbol[graph->high[i]];
+			for(a = alphabet.symbol[graph->low[i]]; a <= last; a++){
+				delta[q * k + a] = number[graph->targets[i]];
+			}
+		}
 	}
-	delete_linked_list_deep(char_list);
+	free(order);
+	free(number);
 	
-	//allocate lookup table
-	int nspots = ntc * automaton->n_nodes;
-	automaton->lookup_table = malloc(nspots * sizeof(int));
+	struct partition p;
+	int n_blocks = minimal_partition(&p, n, k, delta, labels);
 	
 	/*
-	 * Fill Lookup table
+	 * Each block becomes a node, numbered in order of its first reachable
+	 * state so the start comes first.  The dead state's block is left out
+	 * unless it is the start itself (if nothing is accepted).
 	 */
-	//default values, indicating no move
-	for(i = 0; i < nspots; i++){
-		automaton->lookup_table[i] = -1;
+	int *new_id = malloc(n_blocks * sizeof(int));
+	for(i = 0; i < n_blocks; i++){
+		new_id[i] = -1;
+	}
+	int dead_block = p.block[dead];
+	int n_new = 0;
+	for(q = 0; q < r; q++){
+		int b = p.block[q];
+		if(new_id[b] < 0 && (b != dead_block || q == 0)){
+			new_id[b] = n_new++;
+		}
+	}
+	
+	int *table = malloc(n_new * k * sizeof(int));
+	int *accept = malloc(n_new * sizeof(int));
+	char *done = calloc(n_new, sizeof(char));
+	for(q = 0; q < r; q++){
+		int id = new_id[p.block[q]];
+		if(id < 0 || done[id]){
+			//one state of each block is enough
+			continue;
+		}
+		done[id] = 1;
+		accept[id] = labels[q] - 1;
+		for(a = 0; a < k; a++){
+			int b = p.block[delta[q * k + a]];
+			table[id * k + a] = (b == dead_block) ? -1 : new_id[b];
+		}
 	}
 	
-	//loop over transitions
+	FiniteAutomaton *automaton;
+	automaton = build_from_table(n_new, &alphabet, table, accept, 0);
+	
+	delete_partition(&p);
+	free(new_id);
+	free(delta);
+	free(labels);
+	free(table);
+	free(accept);
+	free(done);
+	AUTOMATON_SPAN_END(minimize);
+	return automaton;
+}
+
+
+
+int automaton_is_deterministic(FiniteAutomaton *automaton){
+	/**
+	 * Determines if the provided automaton is deterministic by checking to see
+	 * if any of the transitions are epsilon transitions.
+	 */
+	int i, j;
 	for(i = 0; i < automaton->n_nodes; i++){
 		struct automaton_node *node = automaton->nodes[i];
 		for(j = 0; j < node->n_transitions; j++){
 			struct automaton_transition *transition = node->transitions[j];
-			char c = transition->condition;
-			
-			//find index
-			int char_index = -1;
-			for(k = 0; k < ntc; k++){
-				if(c == automaton->transition_chars[k]){
-					char_index = k;
-					break;
-				}
-			}
-			//if no match
-			if(char_index == -1){
-				printf("This should never happen.\n");
-				exit(1);
+			if(transition->is_epsilon){
+				return 0;
 			}
-			
-			//fill in correct entry
-			int address = i * ntc + char_index;
-			automaton->lookup_table[address] = transition->identifier;
 		}
 	}
+	
+	return 1;
 }
 
 
-static int read_lookup_table(FiniteAutomaton *automaton, int id, char cond){
+/*
+ * Regex Methods
+ */
+int automaton_test_string(FiniteAutomaton *automaton, char* string, int length){
 	/**
-	 * Finds and returns the node of the appropriate transition if it exists,
-	 * otherwise, returns -1.
+	 * Uses the provided automaton to test the provided string of the specified
+	 * length.  Deterministic automata run their compiled table, and others
+	 * are simulated bit-parallel without being made deterministic.  Once the
+	 * automaton is frozen (see automaton_freeze), this does not modify it.
+	 * Returns 0 for failure and 1 for success.
 	 */
-	if(automaton == NULL){
-		printf("Are you stupid? \n");
-		exit(1);
+	if(automaton->compiled != NULL){
+		return compiled_automaton_test_string(automaton->compiled, string,
+		                                      length);
 	}
-	if(automaton->lookup_table == NULL){
-		generate_lookup_table(automaton);
+	if(automaton->simulator != NULL){
+		return bit_parallel_test_string(automaton->simulator, string, length);
 	}
-	
-	//get char index
-	int char_index = -1;
-	int i;
-	for(i = 0; i < automaton->n_transition_chars; i++){
-		if(cond == automaton->transition_chars[i]){
-			char_index = i;
-			break;
-		}
-	}
-	
-	//if no character of this type in table
-	if(char_index == -1){
-		return -1;
+	if(!automaton_is_deterministic(automaton)){
+		BitParallelAutomaton *simulator = get_bit_parallel_automaton(automaton);
+		return bit_parallel_test_string(simulator, string, length);
 	}
 	
-	//read from the array
-	int address = id * automaton->n_transition_chars + char_index;
-	return automaton->lookup_table[address];
+	CompiledAutomaton *compiled = get_compiled_automaton(automaton);
+	return compiled_automaton_test_string(compiled, string, length);
 }
 
 
 /*
- * Regex Methods
+ * Tests
  */
-int automaton_test_string(FiniteAutomaton *automaton, char* string, int length){
+static int has_dangling_transition(FiniteAutomaton *automaton){
 	/**
-	 * Uses the provided automaton (assuming it is deterministic) to test the
-	 * provided string of the specified length.  Returns 0 for failure and 1 
-	 * for success.
+	 * Checks that every transition leads to a node of the automaton, and
+	 * that every node but the start can still reach an ending node (so no
+	 * part of the dead block was kept).
 	 */
-	if(!automaton_is_deterministic(automaton)){
-		printf("Cannot test string \"%s\" with a non-deterministic ",string);
-		printf("automaton.  Please convert to a deterministic automaton.\n");
-		return 0;
+	int n = automaton->n_nodes;
+	char *live = calloc(n, sizeof(char));
+	int i, j, changed = 1;
+	for(i = 0; i < n; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		live[i] = node->is_ending_state;
+		for(j = 0; j < node->n_transitions; j++){
+			int target = node->transitions[j]->identifier;
+			if(target < 0 || target >= n){
+				free(live);
+				return 1;
+			}
+		}
 	}
-	
-	//check if lookup table exists yet
-	if(automaton->lookup_table == NULL){
-		generate_lookup_table(automaton);
+	while(changed){
+		changed = 0;
+		for(i = 0; i < n; i++){
+			struct automaton_node *node = automaton->nodes[i];
+			for(j = 0; j < node->n_transitions && !live[i]; j++){
+				if(live[node->transitions[j]->identifier]){
+					live[i] = changed = 1;
+				}
+			}
+		}
 	}
+	int dangling = 0;
+	for(i = 0; i < n; i++){
+		dangling |= !live[i] && i != automaton->starting_state;
+	}
+	free(live);
+	return dangling;
+}
+
+int minimize_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Minimization Tests:\n\n");
 	
+	//patterns and their minimal sizes (mostly above it after determinizing)
+	const char *patterns[] = {"(aa|aaa)*", "(a|b)*abb", "(a|b)*a(a|b)",
+	                          "a*b|ab", "a(a|b)*|b(a|b)*"};
+	int minimal[] = {3, 4, 4, 2, 2};
+	int n_patterns = sizeof(patterns) / sizeof(patterns[0]);
+	char string[12];
+	int failures = 0;
+	srand(1);
 	
-	//do simulation
-	int state = automaton->starting_state;
-	int i;
-	for(i = 0; i < length; i++){
-		char next_char = string[i];
-		int next_id = read_lookup_table(automaton, state, next_char);
-		if(next_id < 0){
-			//no path
-			return 0;
+	int i, j, k;
+	for(i = 0; i < n_patterns; i++){
+		FiniteAutomaton *nfa = automaton_compile_regex(patterns[i]);
+		FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+		FiniteAutomaton *min = create_automaton_deterministic_flags(nfa,
+				AUTOMATON_MINIMIZE);
+		printf("\"%s\": %d states, %d minimized\n", patterns[i], dfa->n_nodes,
+		       min->n_nodes);
+		if(min->n_nodes != minimal[i] || has_dangling_transition(min)){
+			failures++;
 		}
-		state = next_id;
+		for(j = 0; j < 500; j++){
+			int length = rand() % 12;
+			for(k = 0; k < length; k++){
+				string[k] = 'a' + rand() % 3;
+			}
+			if(automaton_test_string(min, string, length) !=
+			   automaton_simulate_string(nfa, string, length)){
+				failures++;
+			}
+		}
+		delete_automaton(nfa);
+		delete_automaton(dfa);
+		delete_automaton(min);
 	}
 	
-	//check if we have a finished state
-	if(automaton->nodes[state]->is_ending_state){
-		return 1;
-	}else{
-		return 0;
+	//nothing accepted: only the start is left, with no transitions
+	FiniteAutomaton *nfa = automaton_compile_regex("ab");
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	for(i = 0; i < dfa->n_nodes; i++){
+		dfa->nodes[i]->is_ending_state = 0;
+	}
+	FiniteAutomaton *min = minimize_automaton(dfa);
+	if(min->n_nodes != 1 || min->nodes[0]->n_transitions != 0){
+		failures++;
 	}
+	delete_automaton(nfa);
+	delete_automaton(dfa);
+	delete_automaton(min);
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
 }
-
-
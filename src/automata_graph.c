@@ -0,0 +1,215 @@
+/**
+ * Contains methods for converting finite automata to and from their compressed
+ * sparse row (graph) layout, in which the transitions of all nodes are stored
+ * contiguously.  The public methods are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+#include "bitset.h"
+
+
+AutomatonGraph *create_automaton_graph(FiniteAutomaton *automaton){
+	/**
+	 * Creates the graph layout of the provided automaton.  The transitions of
+	 * each node keep their relative order.
+	 */
+	int n = automaton->n_nodes;
+	AutomatonGraph *graph = malloc(sizeof(AutomatonGraph));
+	graph->n_nodes = n;
+	graph->starting_state = automaton->starting_state;
+	graph->offsets = malloc((n + 1) * sizeof(int));
+	graph->epsilon_offsets = malloc((n + 1) * sizeof(int));
+	graph->ending = malloc(n * sizeof(unsigned char));
+	graph->tokens = malloc(n * sizeof(int));
+	graph->closures = NULL;
+	graph->important = NULL;
+	
+	//count transitions of each kind
+	int i, j;
+	int n_transitions = 0, n_epsilon = 0;
+	for(i = 0; i < n; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		graph->offsets[i] = n_transitions;
+		graph->epsilon_offsets[i] = n_epsilon;
+		graph->ending[i] = node->is_ending_state ? 1 : 0;
+		graph->tokens[i] = node->token;
+		for(j = 0; j < node->n_transitions; j++){
+			if(node->transitions[j]->is_epsilon){
+				n_epsilon++;
+			}else{
+				n_transitions++;
+			}
+		}
+	}
+	graph->offsets[n] = n_transitions;
+	graph->epsilon_offsets[n] = n_epsilon;
+	graph->n_transitions = n_transitions;
+	graph->n_epsilon = n_epsilon;
+	
+	//fill in the edges
+	graph->targets = malloc(n_transitions * sizeof(int));
+	graph->low = malloc(n_transitions * sizeof(unsigned char));
+	graph->high = malloc(n_transitions * sizeof(unsigned char));
+	graph->epsilon_targets = malloc(n_epsilon * sizeof(int));
+	int t = 0, e = 0;
+	for(i = 0; i < n; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		for(j = 0; j < node->n_transitions; j++){
+			struct automaton_transition *transition = node->transitions[j];
+			if(transition->is_epsilon){
+				graph->epsilon_targets[e++] = transition->identifier;
+			}else{
+				graph->targets[t] = transition->identifier;
+				graph->low[t] = transition->low;
+				graph->high[t] = transition->high;
+				t++;
+			}
+		}
+	}
+	
+	return graph;
+}
+
+
+FiniteAutomaton *create_automaton_from_graph(AutomatonGraph *graph){
+	/**
+	 * Creates an automaton with the structure of the provided graph.  Each
+	 * node lists its character transitions before its epsilon transitions.
+	 */
+	int n = graph->n_nodes;
+	FiniteAutomaton *automaton = create_automaton_empty(n);
+	automaton->starting_state = graph->starting_state;
+	
+	int i, j;
+	for(i = 0; i < n; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		node->is_ending_state = graph->ending[i];
+		node->token = graph->tokens[i];
+		
+		int first = graph->offsets[i];
+		int n_chars = graph->offsets[i + 1] - first;
+		int first_epsilon = graph->epsilon_offsets[i];
+		int n_epsilon = graph->epsilon_offsets[i + 1] - first_epsilon;
+		
+		struct automaton_transition *transitions;
+		transitions = allocate_transitions(automaton, node, n_chars + n_epsilon);
+		for(j = 0; j < n_chars; j++){
+			transitions[j].low = graph->low[first + j];
+			transitions[j].high = graph->high[first + j];
+			transitions[j].identifier = graph->targets[first + j];
+		}
+		for(j = 0; j < n_epsilon; j++){
+			transitions[n_chars + j].is_epsilon = 1;
+			transitions[n_chars + j].identifier = graph->epsilon_targets[first_epsilon + j];
+		}
+	}
+	
+	return automaton;
+}
+
+
+AutomatonGraph *get_automaton_graph(FiniteAutomaton *automaton){
+	/**
+	 * Returns the graph layout of the provided automaton, creating it first if
+	 * that has not been done yet.  The graph belongs to the automaton.
+	 */
+	if(automaton->graph == NULL){
+		automaton->graph = create_automaton_graph(automaton);
+	}
+	return automaton->graph;
+}
+
+
+int automaton_simulate_string(FiniteAutomaton *automaton, char *string,
+                              int length){
+	/**
+	 * Tests the provided string of the specified length against the automaton
+	 * without making it deterministic, by tracking the set of nodes it could
+	 * be in.  Works for any automaton.  Returns 0 for failure and 1 for
+	 * success.
+	 */
+	AutomatonGraph *graph = get_automaton_graph(automaton);
+	int n_words = BITSET_WORDS(graph->n_nodes);
+	uint64_t *current = create_bitset(graph->n_nodes);
+	uint64_t *moves = create_bitset(graph->n_nodes);
+	
+	bitset_set(moves, graph->starting_state);
+	graph_close_state(graph, moves, current);
+	
+	int k, i, e;
+	for(k = 0; k < length && !bitset_is_empty(current, n_words); k++){
+		unsigned char c = string[k];
+		bitset_zero(moves, n_words);
+		for(i = bitset_next(current, n_words, 0); i >= 0;
+		    i = bitset_next(current, n_words, i + 1)){
+			for(e = graph->offsets[i]; e < graph->offsets[i + 1]; e++){
+				if(graph->low[e] <= c && c <= graph->high[e]){
+					bitset_set(moves, graph->targets[e]);
+				}
+			}
+		}
+		graph_close_state(graph, moves, current);
+	}
+	AUTOMATON_STATS_ADD(bytes_matched, k);
+	
+	int accepted = 0;
+	for(i = bitset_next(current, n_words, 0); i >= 0 && !accepted;
+	    i = bitset_next(current, n_words, i + 1)){
+		accepted = graph->ending[i];
+	}
+	
+	free(current);
+	free(moves);
+	return accepted;
+}
+
+
+int graph_byte_classes(AutomatonGraph *graph, unsigned char *classes,
+                       unsigned char *representatives){
+	/**
+	 * Splits the bytes into classes which no transition of the graph tells
+	 * apart: a new class starts wherever some transition's range starts or
+	 * ends.  Fills in the class of each byte and the first byte of each
+	 * class, and returns the number of classes.
+	 */
+	int boundary[257];
+	memset(boundary, 0, sizeof(boundary));
+	int i;
+	for(i = 0; i < graph->n_transitions; i++){
+		boundary[graph->low[i]] = 1;
+		boundary[graph->high[i] + 1] = 1;
+	}
+	
+	int c, n_classes = 0;
+	for(c = 0; c < 256; c++){
+		if(c == 0 || boundary[c]){
+			representatives[n_classes++] = c;
+		}
+		classes[c] = n_classes - 1;
+	}
+	return n_classes;
+}
+
+
+void delete_automaton_graph(AutomatonGraph *graph){
+	/**
+	 * Frees all memory associated with the specified graph
+	 */
+	if(graph == NULL){
+		return;
+	}
+	free(graph->offsets);
+	free(graph->targets);
+	free(graph->low);
+	free(graph->high);
+	free(graph->epsilon_offsets);
+	free(graph->epsilon_targets);
+	free(graph->ending);
+	free(graph->tokens);
+	free(graph->closures);
+	free(graph->important);
+	free(graph);
+}
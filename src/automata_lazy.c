@@ -0,0 +1,274 @@
+/**
+ * Contains methods for matching with a deterministic automaton which is built
+ * lazily, while matching.  Determinization can need exponentially many
+ * states (as for (a|b)*a(a|b)(a|b)...(a|b)), but a single input only ever
+ * visits one state per byte, so only the states the input reaches are made,
+ * and they are kept in a cache of bounded size.  The public methods are
+ * declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+#include "bitset.h"
+#include "hash_table.h"
+
+
+//the cache always holds the dead state, the starting state and one more
+#define LAZY_MIN_STATES 3
+#define LAZY_INITIAL_ROWS 16
+
+
+static void flush_lazy_automaton(LazyAutomaton*);
+
+
+static int add_lazy_state(LazyAutomaton *lazy, uint64_t *set){
+	/**
+	 * Returns the state for the provided set of nodes, making it if it is not
+	 * cached.  If the cache is full, it is flushed first, so the identifiers
+	 * of all other states may change.
+	 */
+	if(count_hash_table(lazy->states) >= lazy->max_states &&
+	   hash_table_find(lazy->states, set) < 0){
+		flush_lazy_automaton(lazy);
+	}
+	
+	int inserted;
+	int id = hash_table_intern(lazy->states, set, &inserted);
+	if(!inserted){
+		return id;
+	}
+	AUTOMATON_STATS_ADD(dfa_states, 1);
+	
+	//make room for the new state's row
+	int n_classes = lazy->n_classes;
+	if(id == lazy->capacity){
+		lazy->capacity *= 2;
+		if(lazy->capacity > lazy->max_states){
+			lazy->capacity = lazy->max_states;
+		}
+		lazy->table = realloc(lazy->table, (unsigned long) lazy->capacity *
+		                                   n_classes * sizeof(int));
+		lazy->accepting = realloc(lazy->accepting, lazy->capacity);
+	}
+	
+	//the empty set is the dead state, which leads back to itself
+	int c, i;
+	int *row = lazy->table + id * n_classes;
+	int n_words = BITSET_WORDS(lazy->graph->n_nodes);
+	int dead = bitset_is_empty(set, n_words);
+	for(c = 0; c < n_classes; c++){
+		row[c] = dead ? id : LAZY_UNKNOWN;
+	}
+	
+	lazy->accepting[id] = 0;
+	for(i = bitset_next(set, n_words, 0); i >= 0;
+	    i = bitset_next(set, n_words, i + 1)){
+		if(lazy->graph->ending[i]){
+			lazy->accepting[id] = 1;
+			break;
+		}
+	}
+	return id;
+}
+
+
+static void flush_lazy_automaton(LazyAutomaton *lazy){
+	/**
+	 * Throws away every cached state, keeping the memory, and makes the dead
+	 * state and the starting state again.  They get the same identifiers as
+	 * before, since they are always made first.
+	 */
+	clear_hash_table(lazy->states);
+	lazy->n_flushes++;
+	
+	uint64_t *empty = create_bitset(lazy->graph->n_nodes);
+	add_lazy_state(lazy, empty);
+	add_lazy_state(lazy, lazy->starting_set);
+	free(empty);
+}
+
+
+static int make_lazy_transition(LazyAutomaton *lazy, int state, int class){
+	/**
+	 * Makes the state reached from the provided state on the provided byte
+	 * class, and records the transition.  If the cache is flushed on the way,
+	 * the transition is not recorded, since the source state is gone.
+	 */
+	AutomatonGraph *graph = lazy->graph;
+	int n_words = BITSET_WORDS(graph->n_nodes);
+	unsigned char c = lazy->representatives[class];
+	
+	//keys move when the table grows, so work from a copy
+	bitset_copy(lazy->current, get_hash_table(lazy->states, state), n_words);
+	bitset_zero(lazy->moves, n_words);
+	int i, e;
+	for(i = bitset_next(lazy->current, n_words, 0); i >= 0;
+	    i = bitset_next(lazy->current, n_words, i + 1)){
+		for(e = graph->offsets[i]; e < graph->offsets[i + 1]; e++){
+			if(graph->low[e] <= c && c <= graph->high[e]){
+				bitset_set(lazy->moves, graph->targets[e]);
+			}
+		}
+	}
+	graph_close_state(graph, lazy->moves, lazy->current);
+	
+	long n_flushes = lazy->n_flushes;
+	int next = add_lazy_state(lazy, lazy->current);
+	if(lazy->n_flushes == n_flushes){
+		lazy->table[state * lazy->n_classes + class] = next;
+	}
+	return next;
+}
+
+
+LazyAutomaton *create_lazy_automaton(FiniteAutomaton *automaton,
+                                     unsigned long memory_limit){
+	/**
+	 * Creates a lazily built deterministic automaton equivalent to the
+	 * provided (usually nondeterministic) automaton.  Its cached states are
+	 * kept to roughly memory_limit bytes, though at least three states are
+	 * always kept.  The automaton may be deleted afterwards; the lazy
+	 * automaton keeps its own copy of the transitions.
+	 */
+	if(automaton == NULL){
+		return NULL;
+	}
+	LazyAutomaton *lazy = malloc(sizeof(LazyAutomaton));
+	AutomatonGraph *graph = create_automaton_graph(automaton);
+	int n_words = BITSET_WORDS(graph->n_nodes);
+	lazy->graph = graph;
+	lazy->n_classes = graph_byte_classes(graph, lazy->classes,
+	                                     lazy->representatives);
+	
+	//per state: its key and hash, up to four index slots, its row and flag
+	unsigned long state_size = n_words * sizeof(uint64_t) +
+	                           sizeof(unsigned long) + 4 * sizeof(int) +
+	                           lazy->n_classes * sizeof(int) + 1;
+	unsigned long max_states = memory_limit / state_size;
+	if(max_states < LAZY_MIN_STATES){
+		max_states = LAZY_MIN_STATES;
+	}
+	if(max_states > 0x7fffffff / lazy->n_classes){
+		max_states = 0x7fffffff / lazy->n_classes;
+	}
+	lazy->max_states = max_states;
+	lazy->n_flushes = 0;
+	
+	lazy->states = create_hash_table(n_words * sizeof(uint64_t));
+	lazy->capacity = LAZY_INITIAL_ROWS;
+	if(lazy->capacity > lazy->max_states){
+		lazy->capacity = lazy->max_states;
+	}
+	lazy->table = malloc(lazy->capacity * lazy->n_classes * sizeof(int));
+	lazy->accepting = malloc(lazy->capacity);
+	lazy->current = create_bitset(graph->n_nodes);
+	lazy->moves = create_bitset(graph->n_nodes);
+	
+	//the dead state and the starting state are made up front
+	lazy->starting_set = create_bitset(graph->n_nodes);
+	bitset_set(lazy->moves, graph->starting_state);
+	graph_close_state(graph, lazy->moves, lazy->starting_set);
+	bitset_zero(lazy->moves, n_words);
+	add_lazy_state(lazy, lazy->moves);
+	lazy->starting_state = add_lazy_state(lazy, lazy->starting_set);
+	
+	return lazy;
+}
+
+
+int lazy_automaton_test_string(LazyAutomaton *lazy, char *string, int length){
+	/**
+	 * Tests the provided string of the specified length against the lazy
+	 * automaton, making any states it reaches which are not cached yet.
+	 * Returns 0 for failure and 1 for success.
+	 */
+	unsigned char *bytes = (unsigned char*) string;
+	int n_classes = lazy->n_classes;
+	
+	int s = lazy->starting_state;
+	int i;
+	for(i = 0; i < length && s != LAZY_DEAD_STATE; i++){
+		int class = lazy->classes[bytes[i]];
+		int next = lazy->table[s * n_classes + class];
+		if(next == LAZY_UNKNOWN){
+			next = make_lazy_transition(lazy, s, class);
+		}
+		s = next;
+	}
+	AUTOMATON_STATS_ADD(bytes_matched, i);
+	return lazy->accepting[s];
+}
+
+
+int count_lazy_states(LazyAutomaton *lazy){
+	/**
+	 * Returns the number of states currently cached.
+	 */
+	return count_hash_table(lazy->states);
+}
+
+
+void delete_lazy_automaton(LazyAutomaton *lazy){
+	/**
+	 * Frees all memory associated with the specified lazy automaton
+	 */
+	if(lazy == NULL){
+		return;
+	}
+	delete_automaton_graph(lazy->graph);
+	delete_hash_table(lazy->states);
+	free(lazy->table);
+	free(lazy->accepting);
+	free(lazy->starting_set);
+	free(lazy->current);
+	free(lazy->moves);
+	free(lazy);
+}
+
+
+/*
+ * Tests
+ */
+int lazy_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Lazy Automaton Tests:\n\n");
+	
+	//the full deterministic automaton has over a million states
+	char pattern[128] = "(a|b)*a";
+	int i, j;
+	for(i = 0; i < 20; i++){
+		strcat(pattern, "(a|b)");
+	}
+	FiniteAutomaton *nfa = automaton_compile_regex(pattern);
+	
+	//budgets from the minimum up to plenty, so flushes are exercised
+	unsigned long limits[] = {0, 4096, 1 << 20};
+	char string[200];
+	int failures = 0;
+	srand(1);
+	for(i = 0; i < 3; i++){
+		LazyAutomaton *lazy = create_lazy_automaton(nfa, limits[i]);
+		for(j = 0; j < 200; j++){
+			int length = rand() % 200;
+			int k;
+			for(k = 0; k < length; k++){
+				string[k] = rand() % 64 ? 'a' + rand() % 2 : 'c';
+			}
+			if(lazy_automaton_test_string(lazy, string, length) !=
+			   automaton_simulate_string(nfa, string, length)){
+				failures++;
+			}
+		}
+		printf("limit %lu: %d states cached, %ld flushes\n", limits[i],
+		       count_lazy_states(lazy), lazy->n_flushes);
+		delete_lazy_automaton(lazy);
+	}
+	delete_automaton(nfa);
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
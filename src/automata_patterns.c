@@ -0,0 +1,169 @@
+/**
+ * Contains methods for matching input against many patterns at once.  The
+ * patterns are merged under a new starting node and made deterministic
+ * together, with each accepting state recording the set of patterns which
+ * accept there, so a single pass over the input finds every pattern that
+ * matches it.  The public methods are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+#include "bitset.h"
+#include "hash_table.h"
+
+
+PatternSet *create_pattern_set(FiniteAutomaton **automata, int n){
+	/**
+	 * Creates a pattern set from the n provided automata (deterministic or
+	 * not).  Pattern i is reported with identifier i.  Distinct sets of
+	 * patterns are only stored once, however many states share them.
+	 */
+	if(n <= 0){
+		return NULL;
+	}
+	int n_words = BITSET_WORDS(n);
+	FiniteAutomaton *merged = create_automaton_union(automata, n);
+	HashTable *sets = create_hash_table(n_words * sizeof(uint64_t));
+	FiniteAutomaton *dfa = create_automaton_deterministic_sets(merged,
+			AUTOMATON_MINIMIZE, sets);
+	
+	PatternSet *patterns = malloc(sizeof(PatternSet));
+	patterns->compiled = compile_automaton(dfa);
+	patterns->n_patterns = n;
+	patterns->n_words = n_words;
+	patterns->n_sets = count_hash_table(sets);
+	
+	//the interned sets are contiguous, in order of identifier
+	unsigned long size = patterns->n_sets * n_words * sizeof(uint64_t);
+	patterns->sets = malloc(size > 0 ? size : 1);
+	if(size > 0){
+		memcpy(patterns->sets, get_hash_table(sets, 0), size);
+	}
+	
+	delete_hash_table(sets);
+	delete_automaton(merged);
+	delete_automaton(dfa);
+	return patterns;
+}
+
+
+uint64_t *pattern_set_match_set(PatternSet *patterns, char *string,
+                                int length){
+	/**
+	 * Returns the set of patterns (as a bitset of identifiers) which accept
+	 * the whole provided string, or NULL if none do.  The set belongs to the
+	 * pattern set and must not be modified.
+	 */
+	CompiledAutomaton *compiled = patterns->compiled;
+	int state = compiled_automaton_run(compiled, compiled->starting_state,
+	                                   string, length);
+	int token = compiled->tokens[state];
+	if(token < 0){
+		return NULL;
+	}
+	return patterns->sets + token * patterns->n_words;
+}
+
+
+int pattern_set_match(PatternSet *patterns, char *string, int length,
+                      int *matches, int max_matches){
+	/**
+	 * Finds every pattern which accepts the whole provided string, and
+	 * writes the identifiers of the first max_matches of them (in increasing
+	 * order) to matches.  Returns the number of patterns which accept.
+	 */
+	uint64_t *set = pattern_set_match_set(patterns, string, length);
+	if(set == NULL){
+		return 0;
+	}
+	
+	int n_matches = 0;
+	int i;
+	for(i = bitset_next(set, patterns->n_words, 0); i >= 0;
+	    i = bitset_next(set, patterns->n_words, i + 1)){
+		if(n_matches < max_matches){
+			matches[n_matches] = i;
+		}
+		n_matches++;
+	}
+	return n_matches;
+}
+
+
+void delete_pattern_set(PatternSet *patterns){
+	/**
+	 * Frees all memory associated with the specified pattern set
+	 */
+	if(patterns == NULL){
+		return;
+	}
+	delete_compiled_automaton(patterns->compiled);
+	free(patterns->sets);
+	free(patterns);
+}
+
+
+/*
+ * Tests
+ */
+int pattern_set_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Pattern Set Tests:\n\n");
+	
+	//overlapping patterns, and more than one word of them
+	FiniteAutomaton *automata[70];
+	int n = 0;
+	const char *fixed[] = {"a*", "a+b?", "(ab)*", "[ab]*b", "b+", "", "x"};
+	int i, j;
+	for(i = 0; i < 7; i++){
+		automata[n++] = automaton_compile_regex(fixed[i]);
+	}
+	for(i = 0; i < 63; i++){
+		char pattern[8];
+		sprintf(pattern, i < 32 ? "%c%c*%c" : "%c%c%c", 'a' + i % 2,
+		        'a' + i / 2 % 2, 'a' + i / 4 % 2);
+		automata[n++] = automaton_compile_regex(pattern);
+	}
+	PatternSet *patterns = create_pattern_set(automata, n);
+	
+	int failures = 0;
+	char string[8];
+	int matches[70];
+	srand(1);
+	for(i = 0; i < 1000; i++){
+		int length = rand() % 8;
+		for(j = 0; j < length; j++){
+			string[j] = 'a' + rand() % 2;
+		}
+		int n_matches = pattern_set_match(patterns, string, length, matches,
+		                                  70);
+		
+		//the identifiers reported must be exactly those accepting
+		int expected = 0;
+		for(j = 0; j < n; j++){
+			if(automaton_simulate_string(automata[j], string, length)){
+				if(expected >= n_matches || matches[expected] != j){
+					failures++;
+				}
+				expected++;
+			}
+		}
+		if(expected != n_matches){
+			failures++;
+		}
+	}
+	printf("%d patterns, %d states, %d distinct sets\n", n,
+	       patterns->compiled->n_states, patterns->n_sets);
+	
+	for(i = 0; i < n; i++){
+		delete_automaton(automata[i]);
+	}
+	delete_pattern_set(patterns);
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
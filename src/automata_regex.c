@@ -0,0 +1,425 @@
+/**
+ * Contains a recursive descent parser compiling regular expressions into
+ * nondeterministic finite automata.  The expression is parsed in one pass,
+ * with every subexpression built straight into a shared builder, so the cost
+ * is linear in the length of the expression.  The public methods are declared
+ * in automata.h.
+ *
+ * Supported syntax:
+ * 	ab	concatenation
+ * 	a|b	alternation
+ * 	a* a+ a?	zero or more, one or more, and zero or one repetitions
+ * 	(a)	grouping
+ * 	.	any byte except a newline
+ * 	[a-z_] [^0-9]	byte classes (a leading ] is taken literally)
+ * 	\n \t \r \f \v \0 \xHH	escaped bytes
+ * 	\d \w \s \D \W \S	digits, word bytes and whitespace, and their complements
+ * Any other escaped byte (such as \* or \\) stands for itself.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+#include "bitset.h"
+
+
+#define REGEX_SET_WORDS BITSET_WORDS(256)
+
+
+struct regex_parser {
+	const char *pattern;
+	int position; //index of the next unread character
+	int failed; //set once an error has been reported
+	AutomatonBuilder *builder;
+};
+
+
+static struct automaton_fragment parse_alternation(struct regex_parser*);
+
+
+static void report_error(struct regex_parser *parser, const char *message){
+	/**
+	 * Reports the first error found in the pattern.  Parsing carries on after
+	 * an error, but its result is thrown away.
+	 */
+	if(!parser->failed){
+		fprintf(stderr, "Cannot compile regex \"%s\": %s at position %d.\n",
+		        parser->pattern, message, parser->position);
+		parser->failed = 1;
+	}
+}
+
+
+static int hex_value(char c){
+	/**
+	 * Returns the value of a hexadecimal digit, or -1 if c is not one.
+	 */
+	if(c >= '0' && c <= '9'){
+		return c - '0';
+	}
+	if(c >= 'a' && c <= 'f'){
+		return c - 'a' + 10;
+	}
+	if(c >= 'A' && c <= 'F'){
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+
+static void add_range(uint64_t *set, int lo, int hi){
+	/**
+	 * Adds the bytes from lo to hi (inclusive) to the set.
+	 */
+	int c;
+	for(c = lo; c <= hi; c++){
+		bitset_set(set, c);
+	}
+}
+
+
+static int class_escape(char c, uint64_t *set){
+	/**
+	 * If c names a class escape (such as the d of \d), adds the class to the
+	 * set and returns one.  Otherwise returns zero.
+	 */
+	uint64_t class[REGEX_SET_WORDS];
+	bitset_zero(class, REGEX_SET_WORDS);
+	
+	switch(c){
+	case 'd': case 'D':
+		add_range(class, '0', '9');
+		break;
+	case 'w': case 'W':
+		add_range(class, '0', '9');
+		add_range(class, 'a', 'z');
+		add_range(class, 'A', 'Z');
+		bitset_set(class, '_');
+		break;
+	case 's': case 'S':
+		add_range(class, '\t', '\r'); //\t \n \v \f \r
+		bitset_set(class, ' ');
+		break;
+	default:
+		return 0;
+	}
+	
+	//upper case escapes are the complements
+	int i;
+	if(c == 'D' || c == 'W' || c == 'S'){
+		for(i = 0; i < REGEX_SET_WORDS; i++){
+			class[i] = ~class[i];
+		}
+	}
+	bitset_union(set, class, REGEX_SET_WORDS);
+	return 1;
+}
+
+
+static int parse_escaped_byte(struct regex_parser *parser){
+	/**
+	 * Reads the escaped byte following a backslash (which has already been
+	 * read) and returns it.  Returns -1 after reporting an error.
+	 */
+	char c = parser->pattern[parser->position];
+	if(c == '\0'){
+		report_error(parser, "trailing backslash");
+		return -1;
+	}
+	parser->position++;
+	
+	switch(c){
+	case 'n': return '\n';
+	case 't': return '\t';
+	case 'r': return '\r';
+	case 'f': return '\f';
+	case 'v': return '\v';
+	case '0': return '\0';
+	case 'x':{
+		int high = hex_value(parser->pattern[parser->position]);
+		int low = high < 0 ? -1 : hex_value(parser->pattern[parser->position + 1]);
+		if(low < 0){
+			report_error(parser, "expected two hexadecimal digits after \\x");
+			return -1;
+		}
+		parser->position += 2;
+		return high * 16 + low;
+	}
+	default:
+		return (unsigned char) c;
+	}
+}
+
+
+static struct automaton_fragment parse_class(struct regex_parser *parser){
+	/**
+	 * Parses a byte class, after its opening bracket, up to and including its
+	 * closing bracket.
+	 */
+	uint64_t set[REGEX_SET_WORDS];
+	bitset_zero(set, REGEX_SET_WORDS);
+	
+	int negated = 0;
+	if(parser->pattern[parser->position] == '^'){
+		negated = 1;
+		parser->position++;
+	}
+	
+	int first = 1;
+	while(parser->pattern[parser->position] != ']' || first){
+		char c = parser->pattern[parser->position];
+		if(c == '\0'){
+			report_error(parser, "missing ]");
+			break;
+		}
+		parser->position++;
+		first = 0;
+		
+		//read one byte, or add a whole class escape
+		int lo = (unsigned char) c;
+		if(c == '\\'){
+			if(class_escape(parser->pattern[parser->position], set)){
+				parser->position++;
+				continue;
+			}
+			lo = parse_escaped_byte(parser);
+			if(lo < 0){
+				break;
+			}
+		}
+		
+		//a - between two bytes makes a range
+		int hi = lo;
+		const char *next = parser->pattern + parser->position;
+		if(next[0] == '-' && next[1] != ']' && next[1] != '\0'){
+			parser->position++;
+			c = parser->pattern[parser->position++];
+			hi = (unsigned char) c;
+			if(c == '\\'){
+				hi = parse_escaped_byte(parser);
+				if(hi < 0){
+					break;
+				}
+			}
+			if(hi < lo){
+				report_error(parser, "range out of order");
+				break;
+			}
+		}
+		add_range(set, lo, hi);
+	}
+	if(!parser->failed){
+		parser->position++; //closing bracket
+	}
+	
+	int i;
+	if(negated){
+		for(i = 0; i < REGEX_SET_WORDS; i++){
+			set[i] = ~set[i];
+		}
+	}
+	return automaton_builder_set(parser->builder, set);
+}
+
+
+static struct automaton_fragment parse_atom(struct regex_parser *parser){
+	/**
+	 * Parses a single byte, byte class or parenthesized group.
+	 */
+	uint64_t set[REGEX_SET_WORDS];
+	char c = parser->pattern[parser->position++];
+	
+	switch(c){
+	case '(':{
+		struct automaton_fragment group = parse_alternation(parser);
+		if(parser->pattern[parser->position] != ')'){
+			report_error(parser, "missing )");
+		}else{
+			parser->position++;
+		}
+		return group;
+	}
+	case '[':
+		return parse_class(parser);
+	case '.':
+		bitset_zero(set, REGEX_SET_WORDS);
+		add_range(set, 0, 255);
+		bitset_clear(set, '\n');
+		return automaton_builder_set(parser->builder, set);
+	case '\\':{
+		bitset_zero(set, REGEX_SET_WORDS);
+		if(class_escape(parser->pattern[parser->position], set)){
+			parser->position++;
+			return automaton_builder_set(parser->builder, set);
+		}
+		int byte = parse_escaped_byte(parser);
+		return automaton_builder_char(parser->builder, byte < 0 ? 0 : byte);
+	}
+	default:
+		return automaton_builder_char(parser->builder, c);
+	}
+}
+
+
+static struct automaton_fragment parse_repetition(struct regex_parser *parser){
+	/**
+	 * Parses an atom followed by any number of *, + and ? operators.
+	 */
+	char c = parser->pattern[parser->position];
+	if(c == '*' || c == '+' || c == '?'){
+		report_error(parser, "nothing to repeat");
+	}
+	struct automaton_fragment fragment = parse_atom(parser);
+	
+	while(1){
+		c = parser->pattern[parser->position];
+		if(c == '*'){
+			fragment = automaton_builder_iteration(parser->builder, fragment);
+		}else if(c == '+'){
+			fragment = automaton_builder_repetition(parser->builder, fragment);
+		}else if(c == '?'){
+			fragment = automaton_builder_optional(parser->builder, fragment);
+		}else{
+			break;
+		}
+		parser->position++;
+	}
+	return fragment;
+}
+
+
+static struct automaton_fragment parse_concatenation(
+		struct regex_parser *parser){
+	/**
+	 * Parses a (possibly empty) sequence of repetitions, up to the next | or
+	 * closing parenthesis.
+	 */
+	char c = parser->pattern[parser->position];
+	if(c == '\0' || c == '|' || c == ')'){
+		return automaton_builder_empty(parser->builder);
+	}
+	
+	struct automaton_fragment fragment = parse_repetition(parser);
+	while(1){
+		c = parser->pattern[parser->position];
+		if(c == '\0' || c == '|' || c == ')' || parser->failed){
+			break;
+		}
+		struct automaton_fragment next = parse_repetition(parser);
+		fragment = automaton_builder_concatenation(parser->builder, fragment,
+		                                           next);
+	}
+	return fragment;
+}
+
+
+static struct automaton_fragment parse_alternation(
+		struct regex_parser *parser){
+	/**
+	 * Parses concatenations separated by |, up to the end of the pattern or
+	 * the closing parenthesis of the current group.
+	 */
+	struct automaton_fragment fragment = parse_concatenation(parser);
+	while(parser->pattern[parser->position] == '|' && !parser->failed){
+		parser->position++;
+		struct automaton_fragment next = parse_concatenation(parser);
+		fragment = automaton_builder_alternation(parser->builder, fragment,
+		                                         next);
+	}
+	return fragment;
+}
+
+
+FiniteAutomaton *automaton_compile_regex(const char *pattern){
+	/**
+	 * Creates a nondeterministic finite automaton accepting exactly the
+	 * strings matched (as a whole) by the provided regular expression.
+	 * Returns NULL if the expression is not valid.
+	 */
+	if(pattern == NULL){
+		return NULL;
+	}
+	AUTOMATON_SPAN_BEGIN(regex);
+	struct regex_parser parser;
+	parser.pattern = pattern;
+	parser.position = 0;
+	parser.failed = 0;
+	parser.builder = create_automaton_builder();
+	
+	struct automaton_fragment fragment = parse_alternation(&parser);
+	if(!parser.failed && pattern[parser.position] != '\0'){
+		report_error(&parser, "unmatched )");
+	}
+	FiniteAutomaton *automaton = NULL;
+	if(parser.failed){
+		delete_automaton_builder(parser.builder);
+	}else{
+		automaton = automaton_builder_finish(parser.builder, fragment);
+	}
+	AUTOMATON_SPAN_END(regex);
+	return automaton;
+}
+
+
+/*
+ * Tests
+ */
+int regex_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Regex Tests:\n\n");
+	
+	struct {
+		const char *pattern;
+		const char *string;
+		int expected;
+	} cases[] = {
+		{"abc", "abc", 1},
+		{"abc", "ab", 0},
+		{"a|bc", "bc", 1},
+		{"(g*h)*", "g", 0},
+		{"(g*h)*", "gghh", 1},
+		{"a+b?", "aaa", 1},
+		{"a+b?", "b", 0},
+		{"[a-c]*x", "abcbx", 1},
+		{"[^a-c]", "d", 1},
+		{"[^a-c]", "b", 0},
+		{"[]a]+", "]a]", 1},
+		{"\\d+\\.\\d*", "12.", 1},
+		{"\\w\\s\\W", "a !", 1},
+		{"a.c", "a\nc", 0},
+		{"\\x41\\t", "A\t", 1},
+		{"(|a)b", "b", 1},
+		{"", "", 1},
+	};
+	int n_cases = sizeof(cases) / sizeof(cases[0]);
+	int failures = 0;
+	
+	int i;
+	for(i = 0; i < n_cases; i++){
+		FiniteAutomaton *nfa = automaton_compile_regex(cases[i].pattern);
+		char *string = (char*) cases[i].string;
+		int length = strlen(string);
+		if(nfa == NULL ||
+		   automaton_simulate_string(nfa, string, length) != cases[i].expected){
+			printf("Failed: \"%s\" on \"%s\"\n", cases[i].pattern, string);
+			failures++;
+		}
+		delete_automaton(nfa);
+	}
+	
+	//invalid patterns are refused
+	const char *invalid[] = {"(a", "a)", "*a", "[a-", "[z-a]", "a\\"};
+	for(i = 0; i < 6; i++){
+		FiniteAutomaton *nfa = automaton_compile_regex(invalid[i]);
+		if(nfa != NULL){
+			failures++;
+			delete_automaton(nfa);
+		}
+	}
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,569 @@
+/**
+ * Contains methods for finding matches anywhere in a buffer, rather than
+ * testing whether the whole buffer is accepted.  Matches are leftmost-longest:
+ * the match starting earliest wins, and of the matches starting there, the
+ * longest.
+ *
+ * Three deterministic automata are used, each over the haystack once.  The
+ * unanchored one accepts any input ending with a match (the pattern prefixed
+ * by .*, where . is any byte), so a forward pass tells whether there is a
+ * match at all.  Most bytes of a typical haystack cannot start a match, so
+ * whenever it is idle (in its starting state) that pass skips ahead to the
+ * next byte which can, using memchr or SSE2/AVX2 compares rather than the
+ * table.  The reversed one accepts the reverse of any input starting with a
+ * match, so a backward pass from the end of the haystack marks every position
+ * where a match starts; the end of the earliest match is not enough, since a
+ * match starting before it may end after it.  The anchored one is the pattern
+ * itself, run forward once from the leftmost start to find the longest match.
+ * The public methods are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "automata.h"
+
+
+//first byte sets at most this large are scanned for with vector compares
+#define SEARCH_SIMD_BYTES 4
+
+
+static int next_candidate(Searcher *searcher, unsigned char *bytes,
+                          int position, int length){
+	/**
+	 * Returns the first position from position on where a match could start,
+	 * or -1 if there is none.  A match starts with the searcher's literal
+	 * prefix, if it has one, and otherwise with one of its first bytes.  An
+	 * empty match can start anywhere, even at the end.
+	 */
+	if(searcher->n_first == 256){
+		return position <= length ? position : -1;
+	}
+	int i = position;
+	
+	//a literal prefix: find its first byte, then compare the rest
+	if(searcher->prefix_length > 1){
+		int n = searcher->prefix_length;
+		while(i + n <= length){
+			unsigned char *found = memchr(bytes + i, searcher->prefix[0],
+			                              length - n + 1 - i);
+			if(found == NULL){
+				return -1;
+			}
+			i = found - bytes;
+			if(memcmp(bytes + i + 1, searcher->prefix + 1, n - 1) == 0){
+				return i;
+			}
+			i++;
+		}
+		return -1;
+	}
+	
+	if(searcher->n_first == 1){
+		unsigned char *found = memchr(bytes + i, searcher->first[0],
+		                              length - i);
+		return found == NULL ? -1 : found - bytes;
+	}
+	
+	//a few possible first bytes: compare a whole vector against each
+	if(searcher->n_first <= SEARCH_SIMD_BYTES){
+		int k;
+#if defined(__AVX2__)
+		__m256i wide[SEARCH_SIMD_BYTES];
+		for(k = 0; k < searcher->n_first; k++){
+			wide[k] = _mm256_set1_epi8(searcher->first[k]);
+		}
+		for(; i + 32 <= length; i += 32){
+			__m256i block = _mm256_loadu_si256((__m256i*) (bytes + i));
+			__m256i hits = _mm256_cmpeq_epi8(block, wide[0]);
+			for(k = 1; k < searcher->n_first; k++){
+				hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, wide[k]));
+			}
+			unsigned int mask = _mm256_movemask_epi8(hits);
+			if(mask != 0){
+				return i + __builtin_ctz(mask);
+			}
+		}
+#endif
+#if defined(__SSE2__)
+		__m128i narrow[SEARCH_SIMD_BYTES];
+		for(k = 0; k < searcher->n_first; k++){
+			narrow[k] = _mm_set1_epi8(searcher->first[k]);
+		}
+		for(; i + 16 <= length; i += 16){
+			__m128i block = _mm_loadu_si128((__m128i*) (bytes + i));
+			__m128i hits = _mm_cmpeq_epi8(block, narrow[0]);
+			for(k = 1; k < searcher->n_first; k++){
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, narrow[k]));
+			}
+			unsigned int mask = _mm_movemask_epi8(hits);
+			if(mask != 0){
+				return i + __builtin_ctz(mask);
+			}
+		}
+#endif
+	}
+	
+	//anything else (and the tail of the vector loops) goes byte by byte
+	for(; i < length; i++){
+		if(searcher->can_start[bytes[i]]){
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+static void find_prefilter(Searcher *searcher){
+	/**
+	 * Works out which bytes can start a match, and the literal every match
+	 * starts with (the bytes read while the anchored automaton has only one
+	 * way forward), from the anchored automaton's table.
+	 */
+	CompiledAutomaton *compiled = searcher->anchored;
+	unsigned long n_classes = compiled->n_classes;
+	int start = compiled->starting_state;
+	
+	//an empty match can start anywhere
+	searcher->n_first = 0;
+	searcher->prefix_length = 0;
+	if(compiled->accepting[start]){
+		searcher->n_first = 256;
+		memset(searcher->can_start, 1, 256);
+		return;
+	}
+	
+	int c;
+	for(c = 0; c < 256; c++){
+		uint32_t next = compiled_automaton_entry(compiled,
+				start * n_classes + compiled->classes[c]);
+		searcher->can_start[c] = next != COMPILED_DEAD_STATE;
+		if(searcher->can_start[c]){
+			searcher->first[searcher->n_first++] = c;
+		}
+	}
+	
+	int state = start;
+	while(searcher->prefix_length < SEARCHER_MAX_PREFIX &&
+	      !compiled->accepting[state]){
+		int n_ways = 0, byte = 0;
+		for(c = 0; c < 256 && n_ways < 2; c++){
+			if(compiled_automaton_entry(compiled,
+					state * n_classes + compiled->classes[c]) !=
+			   COMPILED_DEAD_STATE){
+				n_ways++;
+				byte = c;
+			}
+		}
+		if(n_ways != 1){
+			break;
+		}
+		searcher->prefix[searcher->prefix_length++] = byte;
+		state = compiled_automaton_entry(compiled,
+				state * n_classes + compiled->classes[byte]);
+	}
+}
+
+
+static FiniteAutomaton *create_automaton_reversed(FiniteAutomaton *automaton){
+	/**
+	 * Creates an automaton accepting the reverse of each string the provided
+	 * one accepts: every transition is turned around, a new starting node has
+	 * epsilon transitions to the old ending nodes, and the old starting node
+	 * is the only ending node.  The provided automaton is not changed.
+	 */
+	int n = automaton->n_nodes;
+	FiniteAutomaton *reversed = create_automaton_empty(n + 1);
+	int *n_into = calloc(n + 1, sizeof(int));
+	
+	//count the transitions into each node, which become its own
+	int i, j;
+	for(i = 0; i < n; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		for(j = 0; j < node->n_transitions; j++){
+			n_into[node->transitions[j]->identifier]++;
+		}
+		if(node->is_ending_state){
+			n_into[n]++;
+		}
+	}
+	struct automaton_transition **added;
+	added = malloc((n + 1) * sizeof(struct automaton_transition*));
+	for(i = 0; i <= n; i++){
+		added[i] = n_into[i] == 0 ? NULL :
+				allocate_transitions(reversed, reversed->nodes[i], n_into[i]);
+	}
+	
+	//turn each transition around
+	for(i = 0; i < n; i++){
+		struct automaton_node *node = automaton->nodes[i];
+		for(j = 0; j < node->n_transitions; j++){
+			struct automaton_transition *t = node->transitions[j];
+			struct automaton_transition *back = added[t->identifier]++;
+			back->is_epsilon = t->is_epsilon;
+			back->low = t->low;
+			back->high = t->high;
+			back->identifier = i;
+		}
+		if(node->is_ending_state){
+			struct automaton_transition *back = added[n]++;
+			back->is_epsilon = 1;
+			back->identifier = i;
+		}
+	}
+	reversed->starting_state = n;
+	reversed->nodes[automaton->starting_state]->is_ending_state = 1;
+	
+	free(added);
+	free(n_into);
+	return reversed;
+}
+
+
+Searcher *create_searcher(FiniteAutomaton *automaton){
+	/**
+	 * Creates a searcher for matches of the provided automaton (which may be
+	 * nondeterministic) anywhere in a buffer.  The automaton is not changed,
+	 * and may be deleted afterwards.
+	 */
+	if(automaton == NULL){
+		return NULL;
+	}
+	FiniteAutomaton *anchored, *unanchored, *reversed, *prefixed;
+	anchored = create_automaton_deterministic_flags(automaton,
+	                                                AUTOMATON_MINIMIZE);
+	prefixed = create_automaton_concatenation_move(
+			create_automaton_iteration_move(create_automaton_range(0, 255)),
+			copy_automaton(automaton));
+	unanchored = create_automaton_deterministic_flags(prefixed,
+	                                                  AUTOMATON_MINIMIZE);
+	delete_automaton(prefixed);
+	prefixed = create_automaton_concatenation_move(
+			create_automaton_iteration_move(create_automaton_range(0, 255)),
+			create_automaton_reversed(automaton));
+	reversed = create_automaton_deterministic_flags(prefixed,
+	                                                AUTOMATON_MINIMIZE);
+	
+	Searcher *searcher = malloc(sizeof(Searcher));
+	searcher->anchored = compile_automaton(anchored);
+	searcher->unanchored = compile_automaton(unanchored);
+	searcher->reversed = compile_automaton(reversed);
+	find_prefilter(searcher);
+	
+	delete_automaton(anchored);
+	delete_automaton(unanchored);
+	delete_automaton(reversed);
+	delete_automaton(prefixed);
+	return searcher;
+}
+
+
+/*
+ * Runs the unanchored automaton from position, and returns the position just
+ * after the earliest match end, or -1 if no match starts at or after position.
+ * While the automaton is in its starting state no match is in progress, so it
+ * skips to the next position where one could start.  Expanded once for each
+ * width of table entry, like the loops in automata_compiled.c.
+ */
+#define DEFINE_EARLIEST_END(type) \
+static int earliest_end_##type(Searcher *searcher, unsigned char *bytes, \
+                               int position, int length){ \
+	CompiledAutomaton *compiled = searcher->unanchored; \
+	type *table = compiled->table; \
+	unsigned char *classes = compiled->classes; \
+	unsigned char *accepting = compiled->accepting; \
+	int n_classes = compiled->n_classes; \
+	uint32_t start = compiled->starting_state; \
+	if(accepting[start]){ \
+		return position; \
+	} \
+	uint32_t s = start; \
+	int i = position; \
+	while(i < length){ \
+		if(s == start){ \
+			i = next_candidate(searcher, bytes, i, length); \
+			if(i < 0){ \
+				return -1; \
+			} \
+		} \
+		s = table[s * n_classes + classes[bytes[i++]]]; \
+		if(accepting[s]){ \
+			return i; \
+		} \
+	} \
+	return -1; \
+}
+
+DEFINE_EARLIEST_END(uint8_t)
+DEFINE_EARLIEST_END(uint16_t)
+DEFINE_EARLIEST_END(uint32_t)
+
+
+static int find_earliest_end(Searcher *searcher, unsigned char *bytes,
+                             int position, int length){
+	/**
+	 * Runs the unanchored automaton with the loop for its width of table.
+	 */
+	switch(searcher->unanchored->state_size){
+		case 1:
+			return earliest_end_uint8_t(searcher, bytes, position, length);
+		case 2:
+			return earliest_end_uint16_t(searcher, bytes, position, length);
+		default:
+			return earliest_end_uint32_t(searcher, bytes, position, length);
+	}
+}
+
+
+/*
+ * Runs the reversed automaton backwards from the end of the haystack down to
+ * position, and returns the first position from position on where a match
+ * starts, or -1 if there is none.  If starts is not NULL, each position where
+ * a match starts is also marked with a one there (it must be zeroed first).
+ * Expanded once for each width of table entry.
+ */
+#define DEFINE_MATCH_STARTS(type) \
+static int match_starts_##type(Searcher *searcher, unsigned char *bytes, \
+                               int position, int length, \
+                               unsigned char *starts){ \
+	CompiledAutomaton *compiled = searcher->reversed; \
+	type *table = compiled->table; \
+	unsigned char *classes = compiled->classes; \
+	unsigned char *accepting = compiled->accepting; \
+	int n_classes = compiled->n_classes; \
+	uint32_t s = compiled->starting_state; \
+	if(accepting[s]){ \
+		if(starts != NULL){ \
+			memset(starts + position, 1, length + 1 - position); \
+		} \
+		return position; \
+	} \
+	int i, leftmost = -1; \
+	for(i = length - 1; i >= position; i--){ \
+		s = table[s * n_classes + classes[bytes[i]]]; \
+		if(accepting[s]){ \
+			leftmost = i; \
+			if(starts != NULL){ \
+				starts[i] = 1; \
+			} \
+		} \
+	} \
+	return leftmost; \
+}
+
+DEFINE_MATCH_STARTS(uint8_t)
+DEFINE_MATCH_STARTS(uint16_t)
+DEFINE_MATCH_STARTS(uint32_t)
+
+static int find_match_starts(Searcher *searcher, unsigned char *bytes,
+                             int position, int length, unsigned char *starts){
+	/**
+	 * Runs the reversed automaton with the loop for its width of table.
+	 */
+	switch(searcher->reversed->state_size){
+		case 1:
+			return match_starts_uint8_t(searcher, bytes, position, length,
+			                            starts);
+		case 2:
+			return match_starts_uint16_t(searcher, bytes, position, length,
+			                             starts);
+		default:
+			return match_starts_uint32_t(searcher, bytes, position, length,
+			                             starts);
+	}
+}
+
+
+static int find_longest(Searcher *searcher, char *haystack, int length,
+                        int start, struct token *match){
+	/**
+	 * Runs the anchored automaton forward from start, and writes the longest
+	 * match starting there to match.  Returns 1, or 0 if there is no match
+	 * there (only if the automata disagree).
+	 */
+	CompiledAutomaton *compiled = searcher->anchored;
+	int state = compiled->starting_state;
+	int last_accept = compiled->accepting[state] ? 0 : -1;
+	int accept_state = state;
+	compiled_automaton_run_longest(compiled, state, haystack + start,
+	                               length - start, &last_accept, &accept_state);
+	if(last_accept < 0){
+		return 0;
+	}
+	match->token_id = compiled->tokens[accept_state];
+	match->offset = start;
+	match->length = last_accept;
+	return 1;
+}
+
+
+int searcher_find(Searcher *searcher, char *haystack, int length, int from,
+                  struct token *match){
+	/**
+	 * Finds the leftmost-longest match in the haystack of the specified
+	 * length which starts at or after from.  If there is one, its offset,
+	 * length and token are written to match and 1 is returned; otherwise 0.
+	 * Takes time linear in the length of the haystack after from.
+	 */
+	unsigned char *bytes = (unsigned char*) haystack;
+	if(from > length || find_earliest_end(searcher, bytes, from, length) < 0){
+		return 0;
+	}
+	int start = find_match_starts(searcher, bytes, from, length, NULL);
+	if(start < 0){
+		return 0;
+	}
+	return find_longest(searcher, haystack, length, start, match);
+}
+
+
+int searcher_find_all(Searcher *searcher, char *haystack, int length,
+                      struct token *matches, int max_matches){
+	/**
+	 * Finds the successive non-overlapping leftmost-longest matches in the
+	 * haystack of the specified length, writing the first max_matches of them
+	 * to matches.  After an empty match the search resumes one byte later.
+	 * Returns the number of matches found.  Whether a match starts at a
+	 * position does not depend on where the search resumed, so the starts
+	 * are all found in one backward pass.
+	 */
+	unsigned char *bytes = (unsigned char*) haystack;
+	if(find_earliest_end(searcher, bytes, 0, length) < 0){
+		return 0;
+	}
+	unsigned char *starts = calloc(length + 1, 1);
+	find_match_starts(searcher, bytes, 0, length, starts);
+	
+	int n_matches = 0;
+	int position = 0;
+	struct token match;
+	while(position <= length){
+		unsigned char *next = memchr(starts + position, 1,
+		                             length + 1 - position);
+		if(next == NULL ||
+		   !find_longest(searcher, haystack, length, next - starts, &match)){
+			break;
+		}
+		if(n_matches < max_matches){
+			matches[n_matches] = match;
+		}
+		n_matches++;
+		position = match.offset + (match.length > 0 ? match.length : 1);
+	}
+	free(starts);
+	return n_matches;
+}
+
+
+void delete_searcher(Searcher *searcher){
+	/**
+	 * Frees all memory associated with the specified searcher
+	 */
+	if(searcher == NULL){
+		return;
+	}
+	delete_compiled_automaton(searcher->anchored);
+	delete_compiled_automaton(searcher->unanchored);
+	delete_compiled_automaton(searcher->reversed);
+	free(searcher);
+}
+
+
+/*
+ * Tests
+ */
+static int reference_find(FiniteAutomaton *nfa, char *haystack, int length,
+                          int from, struct token *match){
+	/**
+	 * Leftmost-longest search by brute force: every substring in turn.
+	 */
+	int start, end;
+	for(start = from; start <= length; start++){
+		for(end = length; end >= start; end--){
+			if(automaton_simulate_string(nfa, haystack + start, end - start)){
+				match->offset = start;
+				match->length = end - start;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int search_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Search Tests:\n\n");
+	
+	//a literal prefix, a few first bytes, many first bytes, empty matches,
+	//and leftmost matches ending after the earliest match end
+	const char *patterns[] = {
+		"abc(d|e)*", "(b|c)a+", "[a-d]c", "a*", "x?b", "(ab|ba)+", "zz",
+		"abcd|c", "a[^b]*c|b",
+	};
+	int n_patterns = sizeof(patterns) / sizeof(patterns[0]);
+	char haystack[64];
+	int failures = 0;
+	srand(1);
+	
+	int i, j, k;
+	for(i = 0; i < n_patterns; i++){
+		FiniteAutomaton *nfa = automaton_compile_regex(patterns[i]);
+		Searcher *searcher = create_searcher(nfa);
+		for(j = 0; j < 300; j++){
+			int length = rand() % 64;
+			for(k = 0; k < length; k++){
+				haystack[k] = "abcdexy"[rand() % 7];
+			}
+			int from = length > 0 ? rand() % length : 0;
+			struct token found, expected;
+			int has = searcher_find(searcher, haystack, length, from, &found);
+			int want = reference_find(nfa, haystack, length, from, &expected);
+			if(has != want || (has && (found.offset != expected.offset ||
+			                           found.length != expected.length))){
+				failures++;
+			}
+		}
+		printf("\"%s\": %d first bytes, prefix of %d\n", patterns[i],
+		       searcher->n_first, searcher->prefix_length);
+		delete_searcher(searcher);
+		delete_automaton(nfa);
+	}
+	
+	//all matches
+	FiniteAutomaton *nfa = automaton_compile_regex("ab+");
+	Searcher *searcher = create_searcher(nfa);
+	struct token matches[4];
+	char *text = "xxabbbyabxab";
+	int n = searcher_find_all(searcher, text, strlen(text), matches, 4);
+	if(n != 3 || matches[0].offset != 2 || matches[0].length != 4 ||
+	   matches[1].offset != 7 || matches[2].offset != 10){
+		failures++;
+	}
+	delete_searcher(searcher);
+	delete_automaton(nfa);
+	
+	//a long run of candidates which only match at the very end
+	nfa = automaton_compile_regex("a[^b]*c|b");
+	searcher = create_searcher(nfa);
+	int long_length = 100000;
+	char *long_text = malloc(long_length);
+	memset(long_text, 'a', long_length - 1);
+	long_text[long_length - 1] = 'b';
+	struct token found;
+	if(!searcher_find(searcher, long_text, long_length, 0, &found) ||
+	   found.offset != long_length - 1 || found.length != 1){
+		failures++;
+	}
+	free(long_text);
+	delete_searcher(searcher);
+	delete_automaton(nfa);
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * Contains the instrumentation counters and timing spans of the library.  The
+ * library only updates them when built with AUTOMATA_STATS defined (for
+ * example with make STATS=1); otherwise the macros in automata.h expand to
+ * nothing and every counter stays zero.  The public methods are declared in
+ * automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "automata.h"
+
+
+AutomatonStats automaton_stats;
+
+static AutomatonTraceHook trace_hook = NULL;
+
+
+unsigned long automaton_stats_clock(){
+	/**
+	 * Returns a monotonic time in nanoseconds, for timing spans.
+	 */
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec * 1000000000UL + time.tv_nsec;
+}
+
+
+void automaton_stats_end_span(const char *span, unsigned long *total,
+                              unsigned long start){
+	/**
+	 * Ends a span begun at start: adds its length to the span's total and
+	 * reports it to the trace hook, if one is set.
+	 */
+	unsigned long elapsed = automaton_stats_clock() - start;
+	__atomic_fetch_add(total, elapsed, __ATOMIC_RELAXED);
+	AutomatonTraceHook hook = __atomic_load_n(&trace_hook, __ATOMIC_ACQUIRE);
+	if(hook != NULL){
+		hook(span, elapsed);
+	}
+}
+
+
+void automaton_get_stats(AutomatonStats *stats){
+	/**
+	 * Copies the current counters into stats.  Counters updated by other
+	 * threads while copying may be read just before or just after an update.
+	 */
+	unsigned long *source = (unsigned long*) &automaton_stats;
+	unsigned long *destination = (unsigned long*) stats;
+	int i;
+	for(i = 0; i < sizeof(AutomatonStats) / sizeof(unsigned long); i++){
+		destination[i] = __atomic_load_n(source + i, __ATOMIC_RELAXED);
+	}
+}
+
+
+void automaton_reset_stats(){
+	/**
+	 * Sets every counter back to zero.
+	 */
+	unsigned long *counters = (unsigned long*) &automaton_stats;
+	int i;
+	for(i = 0; i < sizeof(AutomatonStats) / sizeof(unsigned long); i++){
+		__atomic_store_n(counters + i, 0, __ATOMIC_RELAXED);
+	}
+}
+
+
+void automaton_set_trace_hook(AutomatonTraceHook hook){
+	/**
+	 * Sets the function called with the name and length (in nanoseconds) of
+	 * every span as it ends, or removes it if hook is NULL.  The hook may be
+	 * called from several threads at once.
+	 */
+	__atomic_store_n(&trace_hook, hook, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Tests
+ */
+static int n_spans;
+
+static void count_span(const char *span, unsigned long nanoseconds){
+	/**
+	 * Trace hook counting the spans it is called for.
+	 */
+	n_spans++;
+}
+
+int stats_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Stats Tests:\n\n");
+	
+	automaton_reset_stats();
+	automaton_set_trace_hook(count_span);
+	n_spans = 0;
+	
+	FiniteAutomaton *nfa = automaton_compile_regex("(ab|c)*d");
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	automaton_test_string(dfa, "ababcd", 6);
+	automaton_set_trace_hook(NULL);
+	
+	AutomatonStats stats;
+	automaton_get_stats(&stats);
+	printf("nodes %lu, transitions %lu, closures %lu, states %lu, tables %lu, "
+	       "bytes %lu, spans %d\n", stats.nodes_created,
+	       stats.transitions_created, stats.closures_computed,
+	       stats.dfa_states, stats.tables_compiled, stats.bytes_matched,
+	       n_spans);
+	
+	//without instrumentation everything stays zero
+	int failures = 0;
+#ifdef AUTOMATA_STATS
+	int enabled = 1;
+#else
+	int enabled = 0;
+#endif
+	if((stats.nodes_created > 0) != enabled ||
+	   (stats.dfa_states == dfa->n_nodes) != enabled ||
+	   (stats.tables_compiled == 1) != enabled ||
+	   (stats.bytes_matched == 6) != enabled ||
+	   (n_spans == 3) != enabled){
+		failures++;
+	}
+	
+	automaton_reset_stats();
+	automaton_get_stats(&stats);
+	if(stats.nodes_created != 0 || stats.bytes_matched != 0){
+		failures++;
+	}
+	
+	delete_automaton(nfa);
+	delete_automaton(dfa);
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
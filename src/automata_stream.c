@@ -0,0 +1,132 @@
+/**
+ * Contains methods for matching a deterministic finite automaton against input
+ * which arrives in chunks, such as from a socket or pipe.  The public methods
+ * are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+
+
+int automaton_stream_begin(AutomatonStream *stream, FiniteAutomaton *automaton){
+	/**
+	 * Prepares the stream to match the provided deterministic automaton from
+	 * its starting state.  Returns 0 (leaving the stream unusable) if the
+	 * automaton is not deterministic, otherwise 1.
+	 */
+	stream->compiled = get_compiled_automaton(automaton);
+	if(stream->compiled == NULL){
+		return 0;
+	}
+	
+	stream->state = stream->compiled->starting_state;
+	stream->offset = 0;
+	stream->last_accept = stream->compiled->accepting[stream->state] ? 0 : -1;
+	return 1;
+}
+
+
+int automaton_stream_feed(AutomatonStream *stream, char *chunk, int length){
+	/**
+	 * Advances the stream through the next chunk of input.  Returns 1 if the
+	 * input so far can still be extended to a match, and 0 once it cannot, in
+	 * which case further chunks need not be fed.
+	 */
+	if(stream->state == COMPILED_DEAD_STATE){
+		stream->offset += length;
+		return 0;
+	}
+	
+	int last_accept = -1;
+	int accept_state;
+	stream->state = compiled_automaton_run_longest(stream->compiled,
+	                                               stream->state, chunk, length,
+	                                               &last_accept, &accept_state);
+	if(last_accept >= 0){
+		stream->last_accept = stream->offset + last_accept;
+	}
+	stream->offset += length;
+	
+	return stream->state != COMPILED_DEAD_STATE;
+}
+
+
+int automaton_stream_end(AutomatonStream *stream){
+	/**
+	 * Finishes the stream.  Returns 1 if everything fed was accepted and 0
+	 * otherwise.  The length of the longest accepted prefix remains available
+	 * in last_accept.
+	 */
+	return stream->compiled->accepting[stream->state];
+}
+
+
+/*
+ * Tests
+ */
+int stream_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Stream Tests:\n\n");
+	
+	FiniteAutomaton *nfa = automaton_compile_regex("ab(cd)*");
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	CompiledAutomaton *compiled = get_compiled_automaton(dfa);
+	
+	//accepting states inside the input, and a dead state partway through
+	char *inputs[] = {"abcdcd", "abcdcdxcd", "abcdc", "x", ""};
+	int n_inputs = sizeof(inputs) / sizeof(inputs[0]);
+	int failures = 0;
+	
+	int i, split, j;
+	for(i = 0; i < n_inputs; i++){
+		char *input = inputs[i];
+		int length = strlen(input);
+		
+		//the whole input at once
+		int start = compiled->starting_state;
+		int last_accept = compiled->accepting[start] ? 0 : -1;
+		int accept_state;
+		int state = compiled_automaton_run_longest(compiled, start, input,
+		                                           length, &last_accept,
+		                                           &accept_state);
+		
+		//split in two at every offset, then one byte at a time
+		for(split = 0; split <= length + 1; split++){
+			AutomatonStream stream;
+			automaton_stream_begin(&stream, dfa);
+			if(split <= length){
+				automaton_stream_feed(&stream, input, split);
+				automaton_stream_feed(&stream, input + split, length - split);
+			}else{
+				for(j = 0; j < length; j++){
+					automaton_stream_feed(&stream, input + j, 1);
+				}
+			}
+			if(automaton_stream_end(&stream) != compiled->accepting[state] ||
+			   stream.last_accept != last_accept || stream.offset != length){
+				failures++;
+			}
+		}
+	}
+	
+	//once dead, feeding more changes nothing but the offset
+	AutomatonStream stream;
+	automaton_stream_begin(&stream, dfa);
+	if(!automaton_stream_feed(&stream, "ab", 2) ||
+	   automaton_stream_feed(&stream, "x", 1) ||
+	   automaton_stream_feed(&stream, "cd", 2) ||
+	   stream.last_accept != 2 || stream.offset != 5 ||
+	   automaton_stream_end(&stream)){
+		failures++;
+	}
+	
+	delete_automaton(nfa);
+	delete_automaton(dfa);
+	
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
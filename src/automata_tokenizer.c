@@ -0,0 +1,193 @@
+/**
+ * Contains methods for lexical analysis: splitting input into tokens, each
+ * described by its own finite automaton, with longest-match semantics.  The
+ * public methods are declared in automata.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+
+
+struct ranking {
+	int priority;
+	int index;
+};
+
+
+static int compare_rankings(const void *a, const void *b){
+	/**
+	 * Orders token automata by priority, then by index.
+	 */
+	const struct ranking *x = a;
+	const struct ranking *y = b;
+	if(x->priority != y->priority){
+		return x->priority < y->priority ? -1 : 1;
+	}
+	return x->index - y->index;
+}
+
+
+Tokenizer *create_tokenizer(FiniteAutomaton **automata, int *priorities,
+                            int n){
+	/**
+	 * Creates a tokenizer for the n provided token automata (deterministic or
+	 * not).  Token i is reported with identifier i.  When two tokens match the
+	 * same longest input, the one with the lower priority value wins, and ties
+	 * go to the lower identifier.  priorities may be NULL to rank the tokens
+	 * by identifier alone.
+	 */
+	if(n <= 0){
+		return NULL;
+	}
+	
+	//sort the automata by rank
+	struct ranking *ranks = malloc(n * sizeof(struct ranking));
+	int i;
+	for(i = 0; i < n; i++){
+		ranks[i].priority = priorities == NULL ? 0 : priorities[i];
+		ranks[i].index = i;
+	}
+	qsort(ranks, n, sizeof(struct ranking), compare_rankings);
+	
+	Tokenizer *tokenizer = malloc(sizeof(Tokenizer));
+	tokenizer->n_tokens = n;
+	tokenizer->token_ids = malloc(n * sizeof(int));
+	
+	FiniteAutomaton **ranked = malloc(n * sizeof(FiniteAutomaton*));
+	for(i = 0; i < n; i++){
+		ranked[i] = automata[ranks[i].index];
+		tokenizer->token_ids[i] = ranks[i].index;
+	}
+	
+	//merge into one minimal deterministic automaton whose tokens are ranks
+	FiniteAutomaton *merged = create_automaton_union(ranked, n);
+	FiniteAutomaton *dfa;
+	dfa = create_automaton_deterministic_flags(merged, AUTOMATON_MINIMIZE);
+	tokenizer->compiled = compile_automaton(dfa);
+	
+	delete_automaton(merged);
+	delete_automaton(dfa);
+	free(ranked);
+	free(ranks);
+	return tokenizer;
+}
+
+
+int tokenizer_scan(Tokenizer *tokenizer, char *input, int length,
+                   struct token *tokens, int max_tokens, int *consumed){
+	/**
+	 * Splits the input of the specified length into tokens, taking the longest
+	 * match at each position, and writes them to tokens.  Stops at the end of
+	 * the input, when max_tokens tokens have been written, or at the first
+	 * position where no token matches.  Returns the number of tokens written;
+	 * if consumed is not NULL, it is set to the number of bytes they cover.
+	 * Tokens must match at least one byte.
+	 */
+	CompiledAutomaton *compiled = tokenizer->compiled;
+	int position = 0;
+	int n = 0;
+	
+	while(position < length && n < max_tokens){
+		int match_length = -1;
+		int accept_state = COMPILED_DEAD_STATE;
+		compiled_automaton_run_longest(compiled, compiled->starting_state,
+		                               input + position, length - position,
+		                               &match_length, &accept_state);
+		if(match_length <= 0){
+			break;
+		}
+		
+		int rank = compiled->tokens[accept_state];
+		tokens[n].token_id = tokenizer->token_ids[rank];
+		tokens[n].offset = position;
+		tokens[n].length = match_length;
+		n++;
+		position += match_length;
+	}
+	
+	if(consumed != NULL){
+		*consumed = position;
+	}
+	return n;
+}
+
+
+void delete_tokenizer(Tokenizer *tokenizer){
+	/**
+	 * Frees all memory associated with the specified tokenizer
+	 */
+	if(tokenizer == NULL){
+		return;
+	}
+	delete_compiled_automaton(tokenizer->compiled);
+	free(tokenizer->token_ids);
+	free(tokenizer);
+}
+
+
+/*
+ * Tests
+ */
+static int check_tokens(Tokenizer *tokenizer, char *input, int max_tokens,
+                        int *expected, int n_expected, int expected_consumed){
+	/**
+	 * Scans the input and compares the identifiers of the tokens found, and
+	 * the bytes consumed, with those expected.  Returns 1 if they differ.
+	 */
+	struct token tokens[16];
+	int consumed;
+	int n = tokenizer_scan(tokenizer, input, strlen(input), tokens, max_tokens,
+	                       &consumed);
+	if(n != n_expected || consumed != expected_consumed){
+		return 1;
+	}
+	int i, offset = 0;
+	for(i = 0; i < n; i++){
+		if(tokens[i].token_id != expected[i] || tokens[i].offset != offset){
+			return 1;
+		}
+		offset += tokens[i].length;
+	}
+	return 0;
+}
+
+int tokenizer_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Tokenizer Tests:\n\n");
+	
+	//identifiers come before the keyword, so only priorities put it first
+	const char *patterns[] = {"[a-z]+", "if", " +", "[0-9]+", "[0-9]"};
+	int priorities[] = {1, 0, 0, 2, 2};
+	FiniteAutomaton *automata[5];
+	int i;
+	for(i = 0; i < 5; i++){
+		automata[i] = automaton_compile_regex(patterns[i]);
+	}
+	Tokenizer *tokenizer = create_tokenizer(automata, priorities, 5);
+	int failures = 0;
+	
+	//keyword over identifier, longest match, equal priorities by identifier
+	int all[] = {1, 2, 0, 2, 0, 3, 2, 3};
+	failures += check_tokens(tokenizer, "if iff x1 7", 16, all, 8, 11);
+	
+	//stopping at a byte nothing matches, and at max_tokens
+	failures += check_tokens(tokenizer, "if x;y", 16, all, 3, 4);
+	failures += check_tokens(tokenizer, "if iff", 2, all, 2, 3);
+	delete_tokenizer(tokenizer);
+	
+	//without priorities the identifier comes first, so it wins
+	tokenizer = create_tokenizer(automata, NULL, 5);
+	int unranked[] = {0, 2, 0};
+	failures += check_tokens(tokenizer, "if iff", 16, unranked, 3, 6);
+	delete_tokenizer(tokenizer);
+	
+	for(i = 0; i < 5; i++){
+		delete_automaton(automata[i]);
+	}
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
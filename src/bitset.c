@@ -0,0 +1,294 @@
+/**
+ * Functions for creating/manipulating word-packed bitsets.  The whole-set
+ * operations have SSE2 and AVX2 variants, selected at compile time by the
+ * instruction sets the compiler is allowed to use (e.g. -mavx2).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "bitset.h"
+
+
+uint64_t *create_bitset(int n_bits){
+	/**
+	 * Creates and returns an empty bitset able to hold n_bits bits.
+	 */
+	int n_words = BITSET_WORDS(n_bits);
+	if(n_words == 0){
+		n_words = 1;
+	}
+	return calloc(n_words, sizeof(uint64_t));
+}
+
+
+/*
+ * Single bit methods
+ */
+
+void bitset_set(uint64_t *set, int bit){
+	/**
+	 * Adds the specified bit to the set.
+	 */
+	set[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+}
+
+
+void bitset_clear(uint64_t *set, int bit){
+	/**
+	 * Removes the specified bit from the set.
+	 */
+	set[bit >> 6] &= ~((uint64_t) 1 << (bit & 63));
+}
+
+
+int bitset_get(uint64_t *set, int bit){
+	/**
+	 * Returns one if the specified bit is in the set, otherwise zero.
+	 */
+	return (set[bit >> 6] >> (bit & 63)) & 1;
+}
+
+
+/*
+ * Whole set methods
+ */
+
+void bitset_zero(uint64_t *set, int n_words){
+	/**
+	 * Removes every bit from the set.
+	 */
+	memset(set, 0, n_words * sizeof(uint64_t));
+}
+
+
+void bitset_copy(uint64_t *dest, uint64_t *src, int n_words){
+	/**
+	 * Copies src over dest.
+	 */
+	memcpy(dest, src, n_words * sizeof(uint64_t));
+}
+
+
+void bitset_union(uint64_t *dest, uint64_t *src, int n_words){
+	/**
+	 * Adds every bit of src to dest.
+	 */
+	int i = 0;
+#if defined(__AVX2__)
+	for(; i + 4 <= n_words; i += 4){
+		__m256i d = _mm256_loadu_si256((__m256i*) (dest + i));
+		__m256i s = _mm256_loadu_si256((__m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dest + i), _mm256_or_si256(d, s));
+	}
+#elif defined(__SSE2__)
+	for(; i + 2 <= n_words; i += 2){
+		__m128i d = _mm_loadu_si128((__m128i*) (dest + i));
+		__m128i s = _mm_loadu_si128((__m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dest + i), _mm_or_si128(d, s));
+	}
+#endif
+	for(; i < n_words; i++){
+		dest[i] |= src[i];
+	}
+}
+
+
+void bitset_intersect(uint64_t *dest, uint64_t *src, int n_words){
+	/**
+	 * Removes every bit from dest which is not in src.
+	 */
+	int i = 0;
+#if defined(__AVX2__)
+	for(; i + 4 <= n_words; i += 4){
+		__m256i d = _mm256_loadu_si256((__m256i*) (dest + i));
+		__m256i s = _mm256_loadu_si256((__m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dest + i), _mm256_and_si256(d, s));
+	}
+#elif defined(__SSE2__)
+	for(; i + 2 <= n_words; i += 2){
+		__m128i d = _mm_loadu_si128((__m128i*) (dest + i));
+		__m128i s = _mm_loadu_si128((__m128i*) (src + i));
+		_mm_storeu_si128((__m128i*) (dest + i), _mm_and_si128(d, s));
+	}
+#endif
+	for(; i < n_words; i++){
+		dest[i] &= src[i];
+	}
+}
+
+
+int bitset_is_empty(uint64_t *set, int n_words){
+	/**
+	 * Returns one if the set has no bits, otherwise zero.
+	 */
+	int i = 0;
+#if defined(__AVX2__)
+	for(; i + 4 <= n_words; i += 4){
+		__m256i s = _mm256_loadu_si256((__m256i*) (set + i));
+		if(!_mm256_testz_si256(s, s)){
+			return 0;
+		}
+	}
+#elif defined(__SSE2__)
+	for(; i + 2 <= n_words; i += 2){
+		__m128i s = _mm_loadu_si128((__m128i*) (set + i));
+		__m128i zero = _mm_cmpeq_epi8(s, _mm_setzero_si128());
+		if(_mm_movemask_epi8(zero) != 0xffff){
+			return 0;
+		}
+	}
+#endif
+	for(; i < n_words; i++){
+		if(set[i]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+int bitset_equal(uint64_t *set1, uint64_t *set2, int n_words){
+	/**
+	 * Returns one if the two sets have exactly the same bits, otherwise zero.
+	 */
+	int i = 0;
+#if defined(__AVX2__)
+	for(; i + 4 <= n_words; i += 4){
+		__m256i a = _mm256_loadu_si256((__m256i*) (set1 + i));
+		__m256i b = _mm256_loadu_si256((__m256i*) (set2 + i));
+		__m256i diff = _mm256_xor_si256(a, b);
+		if(!_mm256_testz_si256(diff, diff)){
+			return 0;
+		}
+	}
+#elif defined(__SSE2__)
+	for(; i + 2 <= n_words; i += 2){
+		__m128i a = _mm_loadu_si128((__m128i*) (set1 + i));
+		__m128i b = _mm_loadu_si128((__m128i*) (set2 + i));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff){
+			return 0;
+		}
+	}
+#endif
+	for(; i < n_words; i++){
+		if(set1[i] != set2[i]){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+unsigned long bitset_hash(uint64_t *set, int n_words){
+	/**
+	 * Returns a hash of the set's words.
+	 */
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ n_words;
+	int i;
+	for(i = 0; i < n_words; i++){
+		uint64_t k = set[i] * 0xff51afd7ed558ccdULL;
+		k ^= k >> 32;
+		h = (h ^ k) * 0xc4ceb9fe1a85ec53ULL;
+	}
+	h ^= h >> 33;
+	return h;
+}
+
+
+int bitset_count(uint64_t *set, int n_words){
+	/**
+	 * Returns the number of bits in the set.
+	 */
+	int i, count = 0;
+	for(i = 0; i < n_words; i++){
+		count += __builtin_popcountll(set[i]);
+	}
+	return count;
+}
+
+
+int bitset_next(uint64_t *set, int n_words, int from){
+	/**
+	 * Returns the smallest bit in the set which is at least from, or -1 if
+	 * there is none.  To visit every bit:
+	 * 	for(i = bitset_next(s, n, 0); i >= 0; i = bitset_next(s, n, i + 1))
+	 */
+	int w = from >> 6;
+	if(w >= n_words){
+		return -1;
+	}
+	
+	//mask off bits below from in the first word
+	uint64_t word = set[w] & (~(uint64_t) 0 << (from & 63));
+	while(!word){
+		w++;
+		if(w >= n_words){
+			return -1;
+		}
+		word = set[w];
+	}
+	return (w << 6) + __builtin_ctzll(word);
+}
+
+
+/*
+ * Tests
+ */
+int bitset_test(){
+	/**
+	 * Entry point for tests.
+	 */
+	printf("Bitset Tests:\n\n");
+	
+	int n_bits = 300;
+	int n_words = BITSET_WORDS(n_bits);
+	uint64_t *a = create_bitset(n_bits);
+	uint64_t *b = create_bitset(n_bits);
+	int failures = 0;
+	
+	int i;
+	for(i = 0; i < n_bits; i += 7){
+		bitset_set(a, i);
+	}
+	for(i = 0; i < n_bits; i += 3){
+		bitset_set(b, i);
+	}
+	if(bitset_count(a, n_words) != 43 || !bitset_get(a, 294) ||
+	   bitset_get(a, 295)){
+		failures++;
+	}
+	
+	//visiting every bit should give the multiples of seven in order
+	int expected = 0;
+	for(i = bitset_next(a, n_words, 0); i >= 0;
+	    i = bitset_next(a, n_words, i + 1)){
+		if(i != expected){
+			failures++;
+		}
+		expected += 7;
+	}
+	
+	bitset_intersect(a, b, n_words);
+	if(bitset_count(a, n_words) != 15){
+		failures++;
+	}
+	bitset_union(b, a, n_words);
+	if(bitset_count(b, n_words) != 100 || bitset_equal(a, b, n_words)){
+		failures++;
+	}
+	bitset_zero(a, n_words);
+	if(!bitset_is_empty(a, n_words)){
+		failures++;
+	}
+	
+	printf("%d failures\n", failures);
+	free(a);
+	free(b);
+	
+	return failures != 0;
+}
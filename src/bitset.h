@@ -0,0 +1,30 @@
+/**
+ * Functions for sets of non-negative integers packed into arrays of 64 bit
+ * words.  Bit i of a set lives in word i / 64 at position i % 64 (least
+ * significant first).  Functions working on whole sets take the number of
+ * words, which BITSET_WORDS computes from the number of bits.
+ */
+#include <stdint.h>
+
+#define BITSET_WORDS(n_bits) (((n_bits) + 63) / 64)
+
+
+uint64_t *create_bitset(int);
+
+void bitset_set(uint64_t*, int);
+void bitset_clear(uint64_t*, int);
+int bitset_get(uint64_t*, int);
+
+void bitset_zero(uint64_t*, int);
+void bitset_copy(uint64_t*, uint64_t*, int);
+void bitset_union(uint64_t*, uint64_t*, int);
+void bitset_intersect(uint64_t*, uint64_t*, int);
+
+int bitset_is_empty(uint64_t*, int);
+int bitset_equal(uint64_t*, uint64_t*, int);
+unsigned long bitset_hash(uint64_t*, int);
+int bitset_count(uint64_t*, int);
+int bitset_next(uint64_t*, int, int);
+
+//test function
+int bitset_test();
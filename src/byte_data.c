@@ -5,6 +5,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "byte_data.h"
 #include "print.h"
@@ -15,18 +16,7 @@ int compare_byte_data(void *data1, void *data2, unsigned long length){
 	 * Checks to see if the strings of bytes of the specified length (in bytes)
 	 * from the provided pointers are equal.
 	 */
-	int i;
-	for(i = 0; i < length; i++){
-		unsigned char *d1, *d2;
-		d1 = data1 + i;
-		d2 = data2 + i;
-		if(*d1 != *d2){
-			return 0;
-		}
-	}
-	
-	//if we get this far, they must match
-	return 1;
+	return memcmp(data1, data2, length) == 0;
 }
 
 
@@ -34,11 +24,15 @@ int byte_data_is_zero(void *data, unsigned long length){
 	/**
 	 * Checks to see if the specified number of bytes at pointer data are zero.
 	 */
-	void *zero = calloc(length, 1);
-	int result = compare_byte_data(data, zero, length);
-	free(zero);
+	unsigned char *bytes = data;
+	unsigned long i;
+	for(i = 0; i < length; i++){
+		if(bytes[i]){
+			return 0;
+		}
+	}
 	
-	return result;
+	return 1;
 }
 
 
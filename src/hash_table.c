@@ -0,0 +1,272 @@
+/**
+ * Functions for creating/using hash tables of interned byte data.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "byte_data.h"
+#include "hash_table.h"
+
+
+#define HASH_TABLE_INITIAL_SLOTS 16
+
+
+static unsigned long hash_bytes(void *data, unsigned long length){
+	/**
+	 * Hashes the specified number of bytes, eight at a time where possible.
+	 */
+	unsigned char *bytes = data;
+	unsigned long h = 0x9e3779b97f4a7c15UL ^ length;
+	unsigned long i = 0;
+	
+	for(; i + 8 <= length; i += 8){
+		unsigned long k;
+		memcpy(&k, bytes + i, 8);
+		k *= 0xff51afd7ed558ccdUL;
+		k ^= k >> 32;
+		h = (h ^ k) * 0xc4ceb9fe1a85ec53UL;
+	}
+	for(; i < length; i++){
+		h = (h ^ bytes[i]) * 0x100000001b3UL;
+	}
+	
+	//final mixing so the low bits used for slot indices are well spread
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdUL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+static int find_slot(HashTable *table, void *pattern, unsigned long hash){
+	/**
+	 * Returns the slot index holding the key matching pattern, or the index of
+	 * the empty slot where it would be inserted.
+	 */
+	unsigned long mask = table->n_slots - 1;
+	unsigned long slot = hash & mask;
+	
+	while(table->slots[slot] >= 0){
+		int id = table->slots[slot];
+		if(table->hashes[id] == hash){
+			void *key = table->data + id * table->data_size;
+			if(compare_byte_data(key, pattern, table->data_size)){
+				return slot;
+			}
+		}
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+
+static void grow_slots(HashTable *table){
+	/**
+	 * Doubles the size of the index and reinserts every key.
+	 */
+	int i;
+	free(table->slots);
+	table->n_slots *= 2;
+	table->slots = malloc(table->n_slots * sizeof(int));
+	for(i = 0; i < table->n_slots; i++){
+		table->slots[i] = -1;
+	}
+	
+	unsigned long mask = table->n_slots - 1;
+	for(i = 0; i < table->n_entries; i++){
+		unsigned long slot = table->hashes[i] & mask;
+		while(table->slots[slot] >= 0){
+			slot = (slot + 1) & mask;
+		}
+		table->slots[slot] = i;
+	}
+}
+
+
+/*
+ * Methods for creating hash tables
+ */
+
+HashTable *create_hash_table(unsigned long data_size){
+	/**
+	 * Creates and returns an empty hash table for keys of the specified size.
+	 */
+	HashTable *table = malloc(sizeof(HashTable));
+	table->data_size = data_size;
+	table->n_entries = 0;
+	table->capacity = HASH_TABLE_INITIAL_SLOTS / 2;
+	table->n_slots = HASH_TABLE_INITIAL_SLOTS;
+	
+	table->slots = malloc(table->n_slots * sizeof(int));
+	int i;
+	for(i = 0; i < table->n_slots; i++){
+		table->slots[i] = -1;
+	}
+	table->hashes = malloc(table->capacity * sizeof(unsigned long));
+	table->data = malloc(table->capacity * data_size);
+	
+	return table;
+}
+
+
+/*
+ * Methods for manipulating and reading hash tables
+ */
+
+int hash_table_intern(HashTable *table, void *pattern, int *inserted){
+	/**
+	 * Returns the identifier of the key matching the provided pattern, adding
+	 * a copy of the pattern first if it is not yet present.  If inserted is
+	 * not NULL, it is set to one for a new key and zero for an existing one.
+	 */
+	unsigned long hash = hash_bytes(pattern, table->data_size);
+	int slot = find_slot(table, pattern, hash);
+	
+	if(table->slots[slot] >= 0){
+		if(inserted != NULL){
+			*inserted = 0;
+		}
+		return table->slots[slot];
+	}
+	
+	//make room for the new key
+	int id = table->n_entries;
+	if(id == table->capacity){
+		table->capacity *= 2;
+		table->hashes = realloc(table->hashes,
+		                        table->capacity * sizeof(unsigned long));
+		table->data = realloc(table->data, table->capacity * table->data_size);
+	}
+	memcpy(table->data + id * table->data_size, pattern, table->data_size);
+	table->hashes[id] = hash;
+	table->slots[slot] = id;
+	table->n_entries++;
+	
+	//keep the load factor at or below one half
+	if(2 * table->n_entries > table->n_slots){
+		grow_slots(table);
+	}
+	
+	if(inserted != NULL){
+		*inserted = 1;
+	}
+	return id;
+}
+
+
+int hash_table_find(HashTable *table, void *pattern){
+	/**
+	 * Finds the identifier of the key matching the provided pattern.  If no
+	 * such key exists, it returns -1.
+	 */
+	if(table == NULL){
+		return -1;
+	}
+	unsigned long hash = hash_bytes(pattern, table->data_size);
+	return table->slots[find_slot(table, pattern, hash)];
+}
+
+
+void *get_hash_table(HashTable *table, int id){
+	/**
+	 * Returns a pointer to the key with the given identifier if it exists.
+	 * Otherwise, the NULL pointer is returned.  The pointer is only valid
+	 * until the next insertion.
+	 */
+	if(table == NULL || id < 0 || id >= table->n_entries){
+		return NULL;
+	}
+	return table->data + id * table->data_size;
+}
+
+
+int count_hash_table(HashTable *table){
+	/**
+	 * Returns the number of distinct keys in the provided table.
+	 */
+	if(table == NULL){
+		return -1;
+	}
+	return table->n_entries;
+}
+
+
+void clear_hash_table(HashTable *table){
+	/**
+	 * Removes every key from the provided table, keeping its memory so that
+	 * refilling it does not allocate again.
+	 */
+	int i;
+	for(i = 0; i < table->n_slots; i++){
+		table->slots[i] = -1;
+	}
+	table->n_entries = 0;
+}
+
+
+/*
+ * Methods for deleting hash tables
+ */
+
+void delete_hash_table(HashTable *table){
+	/**
+	 * Frees all memory associated with the provided hash table.
+	 */
+	free(table->slots);
+	free(table->hashes);
+	free(table->data);
+	free(table);
+}
+
+
+/*
+ * Tests
+ */
+int hash_table_test(){
+	/**
+	 * Entry point for tests
+	 */
+	printf("Hash Table Tests:\n\n");
+	
+	HashTable *table = create_hash_table(sizeof(int));
+	int failures = 0;
+	int i;
+	for(i = 0; i < 1000; i++){
+		int key = i * 7919;
+		if(hash_table_intern(table, &key, NULL) != i){
+			failures++;
+		}
+	}
+	for(i = 0; i < 1000; i++){
+		int key = i * 7919;
+		int inserted;
+		if(hash_table_intern(table, &key, &inserted) != i || inserted){
+			failures++;
+		}
+	}
+	int missing = 42;
+	if(hash_table_find(table, &missing) != -1){
+		failures++;
+	}
+	
+	//identifiers start over once the table is cleared
+	clear_hash_table(table);
+	int first = 7919;
+	if(hash_table_find(table, &first) != -1 ||
+	   hash_table_intern(table, &first, NULL) != 0){
+		failures++;
+	}
+	clear_hash_table(table);
+	for(i = 0; i < 1000; i++){
+		int key = i * 7919;
+		if(hash_table_intern(table, &key, NULL) != i){
+			failures++;
+		}
+	}
+	
+	printf("%d entries, %d failures\n", count_hash_table(table), failures);
+	delete_hash_table(table);
+	
+	return failures != 0;
+}
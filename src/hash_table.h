@@ -0,0 +1,30 @@
+/**
+ * Hash table for interning blocks of byte data of a fixed size.  Each distinct
+ * block inserted is assigned an identifier, counting up from zero in order of
+ * insertion, so the table doubles as an array of unique keys.  As with linked
+ * lists, the data is compared bytewise.
+ */
+
+typedef struct hash_table {
+	unsigned long data_size;
+	int n_entries; //number of distinct keys stored
+	int capacity; //number of keys the data block can hold
+	int n_slots; //size of the open-addressing index (a power of two)
+	int *slots; //key identifiers, or -1 for an empty slot
+	unsigned long *hashes; //cached hash of each key, indexed by identifier
+	void *data; //keys stored contiguously, indexed by identifier
+} HashTable;
+
+
+HashTable *create_hash_table(unsigned long);
+
+int hash_table_intern(HashTable*, void*, int*);
+int hash_table_find(HashTable*, void*);
+void *get_hash_table(HashTable*, int);
+int count_hash_table(HashTable*);
+void clear_hash_table(HashTable*);
+
+void delete_hash_table(HashTable*);
+
+//test function
+int hash_table_test();
@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "arena.h"
 #include "automata.h"
+#include "bitset.h"
 #include "linked_list.h"
 #include "byte_data.h"
+#include "hash_table.h"
 
 int test();
 int test2();
@@ -17,6 +20,20 @@ int main(int argc, char *argv[]){
 	//status += test2();
 	//status += linked_list_test();
 	//status += byte_data_test();
+	//status += hash_table_test();
+	//status += bitset_test();
+	//status += arena_test();
+	//status += regex_test();
+	//status += minimize_test();
+	//status += binary_test();
+	//status += stream_test();
+	//status += tokenizer_test();
+	//status += lazy_test();
+	//status += bit_parallel_test();
+	//status += batch_test();
+	//status += stats_test();
+	//status += pattern_set_test();
+	//status += search_test();
 	
 	return status;
 }
@@ -0,0 +1,402 @@
+/**
+ * Benchmarks for the automata library: building automata from regular
+ * expressions of growing size, making them deterministic, and matching large
+ * synthetic inputs.  Every case runs in a child process, so the peak memory
+ * reported for it (ru_maxrss) belongs to that case alone.
+ *
+ * Usage: automata_bench [CSV] [JSON]
+ * A summary goes to standard output, and the results are also written as CSV
+ * and as JSON to the given files.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0 //no cycle counter; cycles per byte are reported as 0
+#endif
+
+#include "automata.h"
+
+
+//each measurement repeats the operation for at least this long
+#define BENCH_MIN_SECONDS 0.2
+#define BENCH_CORPUS_SIZE (8 << 20)
+#define BENCH_MAX_RESULTS 64
+
+
+struct result {
+	char benchmark[32];
+	int size; //the benchmark's size parameter
+	int nfa_nodes;
+	int dfa_states;
+	long bytes; //input bytes per operation (matching only)
+	double seconds; //time per operation
+	double cycles_per_byte;
+	long max_rss_kb; //peak resident memory of the process running the case
+};
+
+struct bench_case {
+	const char *benchmark;
+	int size;
+	void (*run)(struct result*);
+};
+
+
+static double now(){
+	/**
+	 * Returns a monotonic time in seconds.
+	 */
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+
+static void random_words(char *pattern, int n_words, const char *separator){
+	/**
+	 * Writes n_words lower case words of four to eight letters, joined by
+	 * the separator, to pattern.  The words are the same on every call.
+	 */
+	srand(n_words);
+	pattern[0] = '\0';
+	int i, j;
+	for(i = 0; i < n_words; i++){
+		char word[9];
+		int length = 4 + rand() % 5;
+		for(j = 0; j < length; j++){
+			word[j] = 'a' + rand() % 26;
+		}
+		word[length] = '\0';
+		if(i > 0){
+			strcat(pattern, separator);
+		}
+		strcat(pattern, word);
+	}
+}
+
+
+static char *suffix_pattern(int k){
+	/**
+	 * Returns (a|b)*a(a|b)...(a|b) with k copies of (a|b) at the end, whose
+	 * deterministic automaton has 2^(k+1) states.
+	 */
+	char *pattern = malloc(16 + 5 * k);
+	strcpy(pattern, "(a|b)*a");
+	int i;
+	for(i = 0; i < k; i++){
+		strcat(pattern, "(a|b)");
+	}
+	return pattern;
+}
+
+
+static char *words_pattern(int n_words){
+	/**
+	 * Returns an alternation of n_words words.
+	 */
+	char *pattern = malloc(n_words * 9 + 1);
+	random_words(pattern, n_words, "|");
+	return pattern;
+}
+
+
+static void time_compile(struct result *result, char *pattern){
+	/**
+	 * Times compiling the pattern into a nondeterministic automaton.
+	 */
+	FiniteAutomaton *nfa = automaton_compile_regex(pattern);
+	result->nfa_nodes = nfa->n_nodes;
+	delete_automaton(nfa);
+	
+	int count = 0;
+	double start = now();
+	do{
+		delete_automaton(automaton_compile_regex(pattern));
+		count++;
+	}while(now() - start < BENCH_MIN_SECONDS);
+	result->seconds = (now() - start) / count;
+}
+
+
+static void time_determinize(struct result *result, char *pattern){
+	/**
+	 * Times making the pattern's automaton deterministic.  This runs once,
+	 * since the largest cases take seconds.
+	 */
+	FiniteAutomaton *nfa = automaton_compile_regex(pattern);
+	result->nfa_nodes = nfa->n_nodes;
+	double start = now();
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	result->seconds = now() - start;
+	result->dfa_states = dfa->n_nodes;
+	delete_automaton(dfa);
+	delete_automaton(nfa);
+}
+
+
+static char *make_corpus(long size){
+	/**
+	 * Returns size bytes of lower case words separated by spaces.
+	 */
+	char *corpus = malloc(size);
+	srand(1);
+	long i;
+	for(i = 0; i < size; i++){
+		corpus[i] = rand() % 6 == 0 ? ' ' : 'a' + rand() % 26;
+	}
+	return corpus;
+}
+
+
+static void time_match(struct result *result, int n_words, int mode){
+	/**
+	 * Times testing a large corpus against [a-z ]*(w1|w2|...)[a-z ]*, which
+	 * never reaches the dead state, with the deterministic automaton (mode
+	 * 0), the bit-parallel simulator (mode 1) or a lazy automaton (mode 2).
+	 */
+	char *words = words_pattern(n_words);
+	char *pattern = malloc(strlen(words) + 32);
+	sprintf(pattern, "[a-z ]*(%s)[a-z ]*", words);
+	FiniteAutomaton *nfa = automaton_compile_regex(pattern);
+	result->nfa_nodes = nfa->n_nodes;
+	
+	FiniteAutomaton *dfa = NULL;
+	LazyAutomaton *lazy = NULL;
+	if(mode == 0){
+		dfa = create_automaton_deterministic(nfa);
+		result->dfa_states = dfa->n_nodes;
+		automaton_freeze(dfa);
+	}else if(mode == 1){
+		automaton_freeze(nfa);
+	}else{
+		lazy = create_lazy_automaton(nfa, 1 << 20);
+	}
+	
+	char *corpus = make_corpus(BENCH_CORPUS_SIZE);
+	result->bytes = BENCH_CORPUS_SIZE;
+	int count = 0;
+	double start = now();
+	unsigned long long cycles = BENCH_CYCLES();
+	do{
+		if(mode == 0){
+			automaton_test_string(dfa, corpus, BENCH_CORPUS_SIZE);
+		}else if(mode == 1){
+			automaton_test_string(nfa, corpus, BENCH_CORPUS_SIZE);
+		}else{
+			lazy_automaton_test_string(lazy, corpus, BENCH_CORPUS_SIZE);
+		}
+		count++;
+	}while(now() - start < BENCH_MIN_SECONDS);
+	cycles = BENCH_CYCLES() - cycles;
+	result->seconds = (now() - start) / count;
+	result->cycles_per_byte = (double) cycles / count / BENCH_CORPUS_SIZE;
+	
+	free(corpus);
+	free(words);
+	free(pattern);
+	delete_lazy_automaton(lazy);
+	delete_automaton(dfa);
+	delete_automaton(nfa);
+}
+
+
+/*
+ * The cases: each runs one benchmark at one size
+ */
+static void compile_words(struct result *result){
+	char *pattern = words_pattern(result->size);
+	time_compile(result, pattern);
+	free(pattern);
+}
+
+static void compile_suffix(struct result *result){
+	char *pattern = suffix_pattern(result->size);
+	time_compile(result, pattern);
+	free(pattern);
+}
+
+static void determinize_words(struct result *result){
+	char *pattern = words_pattern(result->size);
+	time_determinize(result, pattern);
+	free(pattern);
+}
+
+static void determinize_suffix(struct result *result){
+	char *pattern = suffix_pattern(result->size);
+	time_determinize(result, pattern);
+	free(pattern);
+}
+
+static void match_dfa(struct result *result){
+	time_match(result, result->size, 0);
+}
+
+static void match_nfa(struct result *result){
+	time_match(result, result->size, 1);
+}
+
+static void match_lazy(struct result *result){
+	time_match(result, result->size, 2);
+}
+
+
+static int run_case(struct bench_case *c, struct result *result){
+	/**
+	 * Runs one case in a child process, which sends its result back through
+	 * a pipe.  Returns 1 for success and 0 if the child failed.
+	 */
+	memset(result, 0, sizeof(struct result));
+	snprintf(result->benchmark, sizeof(result->benchmark), "%s", c->benchmark);
+	result->size = c->size;
+	
+	int fds[2];
+	if(pipe(fds) != 0){
+		return 0;
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if(pid < 0){
+		close(fds[0]);
+		close(fds[1]);
+		return 0;
+	}
+	if(pid == 0){
+		close(fds[0]);
+		c->run(result);
+		int written = write(fds[1], result, sizeof(struct result));
+		_exit(written == sizeof(struct result) ? 0 : 1);
+	}
+	
+	close(fds[1]);
+	int received = read(fds[0], result, sizeof(struct result));
+	close(fds[0]);
+	int status;
+	struct rusage usage;
+	if(wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+	   WEXITSTATUS(status) != 0 || received != sizeof(struct result)){
+		return 0;
+	}
+	result->max_rss_kb = usage.ru_maxrss;
+	return 1;
+}
+
+
+static void write_csv(FILE *out, struct result *results, int n){
+	/**
+	 * Writes the results as CSV, one row per case.
+	 */
+	fprintf(out, "benchmark,size,nfa_nodes,dfa_states,bytes,seconds,"
+	             "mb_per_second,cycles_per_byte,max_rss_kb\n");
+	int i;
+	for(i = 0; i < n; i++){
+		struct result *r = results + i;
+		double rate = r->bytes > 0 ? r->bytes / r->seconds / 1e6 : 0;
+		fprintf(out, "%s,%d,%d,%d,%ld,%.9f,%.3f,%.3f,%ld\n", r->benchmark,
+		        r->size, r->nfa_nodes, r->dfa_states, r->bytes, r->seconds,
+		        rate, r->cycles_per_byte, r->max_rss_kb);
+	}
+}
+
+
+static void write_json(FILE *out, struct result *results, int n){
+	/**
+	 * Writes the results as a JSON array of objects, one per case.
+	 */
+	fprintf(out, "[\n");
+	int i;
+	for(i = 0; i < n; i++){
+		struct result *r = results + i;
+		double rate = r->bytes > 0 ? r->bytes / r->seconds / 1e6 : 0;
+		fprintf(out, "\t{\"benchmark\": \"%s\", \"size\": %d, "
+		             "\"nfa_nodes\": %d, \"dfa_states\": %d, \"bytes\": %ld, "
+		             "\"seconds\": %.9f, \"mb_per_second\": %.3f, "
+		             "\"cycles_per_byte\": %.3f, \"max_rss_kb\": %ld}%s\n",
+		        r->benchmark, r->size, r->nfa_nodes, r->dfa_states, r->bytes,
+		        r->seconds, rate, r->cycles_per_byte, r->max_rss_kb,
+		        i + 1 < n ? "," : "");
+	}
+	fprintf(out, "]\n");
+}
+
+
+static int write_results(const char *path, struct result *results, int n,
+                         void (*writer)(FILE*, struct result*, int)){
+	/**
+	 * Writes the results to the file at path with the provided writer.
+	 * Returns 1 for success and 0 for failure.
+	 */
+	FILE *out = fopen(path, "w");
+	if(out == NULL){
+		printf("Cannot open \"%s\" for writing.\n", path);
+		return 0;
+	}
+	writer(out, results, n);
+	return fclose(out) == 0;
+}
+
+
+int main(int argc, char *argv[]){
+	if(argc > 3){
+		printf("Usage: %s [CSV] [JSON]\n", argv[0]);
+		return 1;
+	}
+	
+	struct bench_case cases[BENCH_MAX_RESULTS];
+	int n_cases = 0, size;
+	for(size = 16; size <= 4096; size *= 4){
+		cases[n_cases++] = (struct bench_case) {"compile_words", size,
+		                                        compile_words};
+	}
+	for(size = 16; size <= 4096; size *= 4){
+		cases[n_cases++] = (struct bench_case) {"compile_suffix", size,
+		                                        compile_suffix};
+	}
+	for(size = 16; size <= 4096; size *= 4){
+		cases[n_cases++] = (struct bench_case) {"determinize_words", size,
+		                                        determinize_words};
+	}
+	for(size = 2; size <= 16; size += 2){
+		cases[n_cases++] = (struct bench_case) {"determinize_suffix", size,
+		                                        determinize_suffix};
+	}
+	for(size = 4; size <= 64; size *= 4){
+		cases[n_cases++] = (struct bench_case) {"match_dfa", size, match_dfa};
+		cases[n_cases++] = (struct bench_case) {"match_nfa", size, match_nfa};
+		cases[n_cases++] = (struct bench_case) {"match_lazy", size, match_lazy};
+	}
+	
+	struct result results[BENCH_MAX_RESULTS];
+	int n_results = 0, failures = 0;
+	int i;
+	printf("%-20s %6s %8s %8s %12s %10s %8s %10s\n", "benchmark", "size",
+	       "nodes", "states", "seconds", "MB/s", "cyc/B", "rss KB");
+	for(i = 0; i < n_cases; i++){
+		struct result *r = results + n_results;
+		if(!run_case(cases + i, r)){
+			printf("%-20s %6d failed\n", cases[i].benchmark, cases[i].size);
+			failures++;
+			continue;
+		}
+		n_results++;
+		double rate = r->bytes > 0 ? r->bytes / r->seconds / 1e6 : 0;
+		printf("%-20s %6d %8d %8d %12.6f %10.1f %8.2f %10ld\n", r->benchmark,
+		       r->size, r->nfa_nodes, r->dfa_states, r->seconds, rate,
+		       r->cycles_per_byte, r->max_rss_kb);
+	}
+	
+	if(argc > 1 && !write_results(argv[1], results, n_results, write_csv)){
+		failures++;
+	}
+	if(argc > 2 && !write_results(argv[2], results, n_results, write_json)){
+		failures++;
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+/**
+ * Command line front end for the code generator: compiles a regular
+ * expression into a minimal deterministic automaton and writes a standalone C
+ * matcher for it (see generate_automaton_c in automata_codegen.c).
+ *
+ * Usage: automata_gen NAME REGEX [OUTPUT]
+ * The source goes to OUTPUT, or to standard output if it is not given.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "automata.h"
+
+
+int main(int argc, char *argv[]){
+	if(argc < 3 || argc > 4){
+		printf("Usage: %s NAME REGEX [OUTPUT]\n", argv[0]);
+		return 1;
+	}
+	
+	FiniteAutomaton *nfa = automaton_compile_regex(argv[2]);
+	if(nfa == NULL){
+		return 1;
+	}
+	FiniteAutomaton *dfa;
+	dfa = create_automaton_deterministic_flags(nfa, AUTOMATON_MINIMIZE);
+	delete_automaton(nfa);
+	
+	FILE *out = stdout;
+	if(argc == 4){
+		out = fopen(argv[3], "w");
+		if(out == NULL){
+			printf("Cannot open \"%s\" for writing.\n", argv[3]);
+			delete_automaton(dfa);
+			return 1;
+		}
+	}
+	
+	int success = generate_automaton_c(dfa, argv[1], out);
+	if(out != stdout && fclose(out) != 0){
+		success = 0;
+	}
+	delete_automaton(dfa);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/**
+ * Checks a matcher written by automata_gen against the compiled table of the
+ * same expression, on random inputs.  It is linked with the generated code,
+ * whose function name is given with -DGEN_NAME when compiling (`make
+ * generated` does this).
+ *
+ * Usage: automata_gen_check REGEX [N_INPUTS]
+ * Prints the number of disagreements, and exits with 1 if there were any.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "automata.h"
+
+
+#define GEN_JOIN(name, suffix) name##suffix
+#define GEN_LONGEST(name) GEN_JOIN(name, _longest)
+
+int GEN_NAME(const char *string, int length);
+int GEN_LONGEST(GEN_NAME)(const char *string, int length);
+
+//inputs are at most this long
+#define CHECK_MAX_LENGTH 24
+
+
+int main(int argc, char *argv[]){
+	if(argc < 2 || argc > 3){
+		printf("Usage: %s REGEX [N_INPUTS]\n", argv[0]);
+		return 1;
+	}
+	int n_inputs = argc == 3 ? atoi(argv[2]) : 100000;
+	
+	FiniteAutomaton *nfa = automaton_compile_regex(argv[1]);
+	if(nfa == NULL){
+		return 1;
+	}
+	FiniteAutomaton *dfa = create_automaton_deterministic(nfa);
+	CompiledAutomaton *compiled = get_compiled_automaton(dfa);
+	int start = compiled->starting_state;
+	
+	//mostly bytes from the expression itself, so that matches are likely
+	char *regex = argv[1];
+	int regex_length = strlen(regex);
+	char string[CHECK_MAX_LENGTH];
+	int failures = 0;
+	srand(1);
+	
+	int i, j;
+	for(i = 0; i < n_inputs; i++){
+		int length = rand() % (CHECK_MAX_LENGTH + 1);
+		for(j = 0; j < length; j++){
+			if(rand() % 4 == 0){
+				string[j] = rand() % 256;
+			}else{
+				string[j] = regex[rand() % regex_length];
+			}
+		}
+		
+		int last_accept = compiled->accepting[start] ? 0 : -1;
+		int accept_state;
+		compiled_automaton_run_longest(compiled, start, string, length,
+		                               &last_accept, &accept_state);
+		if(GEN_NAME(string, length) !=
+		   compiled_automaton_test_string(compiled, string, length) ||
+		   GEN_LONGEST(GEN_NAME)(string, length) != last_accept){
+			failures++;
+		}
+	}
+	printf("%d inputs, %d disagreements\n", n_inputs, failures);
+	
+	delete_automaton(nfa);
+	delete_automaton(dfa);
+	return failures != 0;
+}